@@ -13,6 +13,27 @@
 #include "shader.h"
 #include "camera.h"
 #include "model.h"
+#include "render_queue.h"
+#include "gl_state.h"
+#include "profiler.h"
+#include "gl_extensions.h"
+#include "upload_ring.h"
+#include "frustum.h"
+#include "occlusion_culler.h"
+#include "auto_exposure.h"
+#include "post_process.h"
+#include "gpu_timer.h"
+#include "dynamic_resolution.h"
+#include "taa.h"
+#include "render_target_pool.h"
+#include "render_graph.h"
+#include "job_system.h"
+#include "lod_group.h"
+#include "shader_permutations.h"
+#include "shader_watcher.h"
+#include "benchmark.h"
+#include "image_compare.h"
+#include "startup_trace.h"
 
 using namespace std;
 
@@ -21,17 +42,45 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 unsigned int loadTexture(const char* path, bool backToLinear=false);
-unsigned int loadHDRTexture(char const* path, bool backToLinear=false);
+// a decoded floating point image, decoded on the job system and uploaded by loadHDRTexture
+struct HDRImage {
+    string path;
+    float* data = nullptr;
+    int width = 0, height = 0, components = 0;
+};
+void decodeHDRImage(HDRImage& image, char const* path);
+unsigned int loadHDRTexture(HDRImage& image);
 unsigned int loadCubemap(vector<std::string> faces);
-void renderScene(Shader& lightingShader, Shader& lightShader, Shader& skyboxShader, Model& myModel, int uboMatrices, int depthCubemap, float far_plane, glm::vec3 lightPos, int envCubemap, int irradianceMap, int prefilterMap, int brdfLUT);
+bool checkGoldenImage(const RGBImage& image, const string& scenario, const string& goldenDirectory, bool updateGolden, const string& outputPrefix);
+void renderScene(Shader& skyboxShader, OcclusionCuller& occlusion, int depthCubemap, int envCubemap, int irradianceMap, int prefilterMap, int brdfLUT);
 void renderLight();
 void renderQuad();
 void renderSphere();
 void renderCube();
 
+// built as the benchmark (AircraftBenchmark.vcxproj) the scripted scenarios of benchmark.h run instead of the
+// input, in a hidden window, and the measured times are written to <output>.csv and <output>.json. Headless
+// machines can run it under a virtual X server with Mesa's llvmpipe:
+//   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run AircraftBenchmark --resources <dir> --output <prefix> [--scenario <name>]
+// With --golden <dir> the last frame of every scenario is compared with <dir>/<scenario>.ppm (see
+// image_compare.h) and the exit code is 1 if one differs, --update-golden <dir> stores the frames there instead.
+// Both builds print where the time until the first frame went, --trace <file> also writes it as a Chrome trace
+// (see startup_trace.h).
+#ifdef AIRCRAFTPBS_BENCHMARK
+const bool benchmarkMode = true;
+#else
+const bool benchmarkMode = false;
+#endif
+
 // settings
+// the models and the environment map are loaded from here, can be set with --resources
+string resourceDirectory = "D:/Projects/Git/AircraftPBS/Resource/";
 const unsigned int SCR_WIDTH = 1600;
 const unsigned int SCR_HEIGHT = 1200;
+const float CAMERA_NEAR_PLANE = 0.1f;
+// size of the window, and of the part of the SCR_WIDTH x SCR_HEIGHT render targets the scene is rendered to
+unsigned int outputWidth = SCR_WIDTH, outputHeight = SCR_HEIGHT;
+unsigned int renderWidth = SCR_WIDTH, renderHeight = SCR_HEIGHT;
 // Options
 bool blinn = true;
 bool blinnKeyPressed = false;
@@ -46,7 +95,23 @@ bool hdr = true;
 bool hdrKeyPressed = false;
 bool bloom = false;
 bool bloomKeyPressed = false;
+bool profilerKeyPressed = false;
+// exposure compensation when auto exposure is on, the exposure itself when it is off
 float exposure = 1.0f;
+bool autoExposure = true;
+bool autoExposureKeyPressed = false;
+bool dynamicResolution = true;
+bool dynamicResolutionKeyPressed = false;
+bool taa = true;
+bool taaKeyPressed = false;
+// prints the passes of the next frame with their resources and GPU times
+bool dumpRenderGraph = false;
+bool dumpRenderGraphKeyPressed = false;
+
+// fleet: FLEET_ROWS x FLEET_COLUMNS copies of the aircraft, FLEET_SPACING apart (1 x 1 is the single hero aircraft)
+const unsigned int FLEET_ROWS = 1;
+const unsigned int FLEET_COLUMNS = 1;
+const float FLEET_SPACING = 40.0f;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -54,13 +119,63 @@ float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
+// draw calls of the shadow and the main pass, sorted by state before submission
+RenderQueue shadowQueue;
+RenderQueue sceneQueue;
+// FrameData and ObjectData uniform blocks and the occlusion candidates of the frames in flight
+UploadRing frameUploads;
+// the draw calls and occlusion candidates one traversal job recorded, merged into the queues by the GL thread
+struct CommandList {
+    RenderQueue shadowQueue;
+    RenderQueue sceneQueue;
+    OcclusionCandidates occlusion;
+};
+vector<CommandList> commandLists;
+
 // timing
 float deltaTime = 0.0f;	// time between current frame and last frame
 float lastFrame = 0.0f;
 
-int main()
+int main(int argc, char* argv[])
 {
+    Benchmark benchmark;
+    benchmark.scenarios = Benchmark::defaultScenarios();
+    string benchmarkOutput = "benchmark";
+    string goldenDirectory;
+    bool updateGolden = false;
+    string tracePath;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        string value = argv[i + 1];
+        if (option == "--resources") {
+            resourceDirectory = value;
+            if (resourceDirectory.back() != '/' && resourceDirectory.back() != '\\')
+                resourceDirectory += '/';
+        }
+        else if (option == "--output") {
+            benchmarkOutput = value;
+        }
+        else if (option == "--golden" || option == "--update-golden") {
+            goldenDirectory = value;
+            updateGolden = option == "--update-golden";
+        }
+        else if (option == "--trace") {
+            tracePath = value;
+        }
+        else if (option == "--scenario") {
+            if (!benchmark.select(value)) {
+                cout << "Unknown benchmark scenario " << value << std::endl;
+                return -1;
+            }
+        }
+        else {
+            cout << "Unknown option " << option << std::endl;
+            return -1;
+        }
+    }
+
     // initialize and configure GLFW
+    unsigned int windowTrace = startupTrace().begin("window and context");
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -69,6 +184,8 @@ int main()
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    if (benchmarkMode)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     // create a window object and make the context of the window the main context on the current thread
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "AircraftPBR", NULL, NULL);
@@ -81,12 +198,18 @@ int main()
     glfwMakeContextCurrent(window);
     // tell GLFW to call the callback function on every window resize by registering it
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    // register the callback functions after we've created the window and before the render loop is initiated.
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+    if (benchmarkMode) {
+        // the benchmark measures frames as fast as they render
+        glfwSwapInterval(0);
+    }
+    else {
+        // register the callback functions after we've created the window and before the render loop is initiated.
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
 
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
 
     // initialize GLAD before we call any OpenGL function (GLAD manages function pointers for OpenGL)
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -94,6 +217,9 @@ int main()
         cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    glExtensions().load((GLADloadproc)glfwGetProcAddress);
+    startupTrace().end(windowTrace);
+    startupTrace().startGpuTiming();
 
     // configure global opengl state
     // glEnable(GL_MULTISAMPLE); // Enabled by default on some drivers, but not all so always enable to make sure
@@ -106,45 +232,110 @@ int main()
     // glEnable(GL_CULL_FACE);
     glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS); // enable seamless cubemap sampling for lower mip levels in the pre-filter map.
 
-    // build and compile our shader program
+    // build and compile our shader program. Compiling is only submitted here, errors are reported on the first use,
+    // so the driver works on all programs while the models load.
     // Shader testShader("test.vs", "", "test.fs");
-    Shader depthShader("shadow_mapping_depth.vs", "shadow_mapping_depth.gs", "shadow_mapping_depth.fs");
+    unsigned int shaderTrace = startupTrace().begin("submit shaders");
+    // the meshes are drawn with variants of these, compiled for the features they request (see ShaderPermutations)
+    ShaderPermutations depthShaders("shadow_mapping_depth.vs", "shadow_mapping_depth.gs", "shadow_mapping_depth.fs", 0);
     // Shader lightingShader("lighting.vs", "", "lighting.fs");
-    Shader pbrShader("pbs.vs", "", "disney_pbs.fs");
+    ShaderPermutations pbrShaders("pbs.vs", "", "disney_pbs.fs", SHADER_SHADOWS | SHADER_PARALLAX | SHADER_EMISSIVE | SHADER_OPACITY);
     Shader lightShader("light.vs", "", "light.fs");
     // Shader hdrShader("hdr.vs", "", "hdr.fs");
     Shader blurShader("blur.vs", "", "blur.fs");
-    Shader bloomFinalShader("bloom_final.vs", "", "bloom_final.fs");
+    // bloom composite, tonemapping and the rest of the per pixel post processing in one pass
+    PostProcessChain postProcess;
     Shader equirectangularToCubemapShader("cubemap.vs", "", "equirectangular_to_cubemap.fs");
     Shader irradianceShader("cubemap.vs", "", "irradiance_convolution.fs");
     Shader prefilterShader("cubemap.vs", "", "prefilter.fs");
     Shader brdfShader("brdf.vs", "", "brdf.fs");
     Shader skyboxShader("skybox.vs", "", "skybox.fs");
+    // the variants of the default toggles for every kind of material, they compile while the models load
+    depthShaders.prepare(0);
+    const unsigned int materialFeatures[] = { 0, SHADER_EMISSIVE, SHADER_OPACITY, SHADER_EMISSIVE | SHADER_OPACITY };
+    for (unsigned int features : materialFeatures)
+        pbrShaders.prepare((shadows ? SHADER_SHADOWS : 0) | (parallax ? SHADER_PARALLAX : 0) | features);
+    postProcess.setStage(POST_BLOOM, bloom);
+    postProcess.setStage(POST_AUTO_EXPOSURE, autoExposure);
+    postProcess.setStage(POST_GAMMA, gammaEnabled);
+    postProcess.prepare(postProcess.stages());
+    postProcess.prepare(postProcess.stages() | POST_SHARPEN);
+    startupTrace().end(shaderTrace);
 
     // load models
-    Model myModel("D:/Projects/Git/AircraftPBS/Resource/Aircraft/sp3 blender low poly.obj");
+    unsigned int modelTrace = startupTrace().begin("load models");
+    // the files of both models and the environment map are read at once on the job system, the GL thread builds
+    // the meshes of a model as soon as its file is read
+    shared_ptr<ModelImport> highPolyImport = ImportModelAsync(resourceDirectory + "Aircraft/sp3 blender high poly.obj");
+    shared_ptr<ModelImport> lowPolyImport = ImportModelAsync(resourceDirectory + "Aircraft/sp3 blender low poly.obj");
+    HDRImage environmentImage;
+    string environmentPath = resourceDirectory + "HDR/small_empty_house_2k.hdr";
+    JobSystem::JobHandle environmentDecode = jobSystem().submit([&environmentImage, &environmentPath]() {
+        decodeHDRImage(environmentImage, environmentPath.c_str());
+    });
+    // levels of detail of the aircraft: the authored high and low poly models and a generated one for distant instances
+    Model highPolyModel(*highPolyImport);
+    Model lowPolyModel(*lowPolyImport);
+    highPolyImport.reset();
+    lowPolyImport.reset();
+    Model simplifiedModel(lowPolyModel, 0.25f, 0.05f);
+    LODGroup aircraftLODs;
+    aircraftLODs.addLevel(&highPolyModel, 0.6f);
+    aircraftLODs.addLevel(&lowPolyModel, 0.15f);
+    aircraftLODs.addLevel(&simplifiedModel, 0.0f);
+    startupTrace().end(modelTrace);
 
     // --------------------------------------------------------------------------------
-    // configure a uniform buffer object
-    // first. We get the relevant block indices
-    unsigned int uniformBlockIndex_pbr = glGetUniformBlockIndex(pbrShader.ID, "Matrices");
-    unsigned int uniformBlockIndex_light = glGetUniformBlockIndex(lightShader.ID, "Matrices");
-    // then we link each shader's uniform block to this uniform binding point
-    glUniformBlockBinding(pbrShader.ID, uniformBlockIndex_pbr, 0);
-    glUniformBlockBinding(lightShader.ID, uniformBlockIndex_light, 0);
-    // Now actually create the buffer
-    unsigned int uboMatrices;
-    glGenBuffers(1, &uboMatrices);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_STATIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    // define the range of the buffer that links to a uniform binding point
-    glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0, 2 * sizeof(glm::mat4)); // or glBindBufferBase(GL_UNIFORM_BUFFER, 0, uboMatrices);
-    // store the projection matrix (we only do this once now) (note: we're not using zoom anymore by changing the FoV)
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    unsigned int stageTrace = startupTrace().begin("create render stages");
+    // configure the uniform blocks: FrameData holds the camera, light and toggles of a frame and ObjectData the
+    // matrices of a single draw call. Both are uploaded once per frame into a triple-buffered upload ring.
+    Shader* blockShaders[] = { &lightShader, &skyboxShader };
+    for (Shader* shader : blockShaders) {
+        shader->setUniformBlockBinding("FrameData", FRAME_UNIFORM_BINDING);
+        shader->setUniformBlockBinding("ObjectData", OBJECT_UNIFORM_BINDING);
+    }
+    depthShaders.setup = [](Shader& shader) {
+        shader.setUniformBlockBinding("FrameData", FRAME_UNIFORM_BINDING);
+        shader.setUniformBlockBinding("ObjectData", OBJECT_UNIFORM_BINDING);
+    };
+    // the IBL and shadow maps are bound to fixed units in renderScene
+    pbrShaders.setup = [](Shader& shader) {
+        shader.setUniformBlockBinding("FrameData", FRAME_UNIFORM_BINDING);
+        shader.setUniformBlockBinding("ObjectData", OBJECT_UNIFORM_BINDING);
+        shader.use();
+        shader.setIntUniform("shadowMap", 8);
+        shader.setIntUniform("irradianceMap", 9);
+        shader.setIntUniform("prefilterMap", 10);
+        shader.setIntUniform("brdfLUT", 11);
+    };
+    frameUploads.init(sizeof(FrameUniforms) + 256 * sizeof(ObjectUniforms));
+
+    // the shaders of the render loop are rebuilt when their files change (the IBL maps are only baked at startup)
+    ShaderWatcher shaderWatcher;
+    shaderWatcher.watch(depthShaders);
+    shaderWatcher.watch(pbrShaders);
+    shaderWatcher.watch(postProcess.shaders());
+    Shader* watchedShaders[] = { &lightShader, &blurShader, &skyboxShader };
+    for (Shader* shader : watchedShaders)
+        shaderWatcher.watch(*shader);
+
+    // occlusion culling of the main pass against the depth of the previous frame
+    OcclusionCuller occlusionCuller;
+    occlusionCuller.init(SCR_WIDTH, SCR_HEIGHT);
+    // exposure of the tonemapper adapted to the brightness of the hdr image
+    AutoExposure autoExposureStage;
+    autoExposureStage.init(SCR_WIDTH, SCR_HEIGHT);
+    // the scene is rendered below the output resolution when the GPU can't hold the frame time
+    GpuTimer gpuTimer;
+    gpuTimer.init();
+    DynamicResolution resolution;
+    // anti-aliasing of the hdr image, the motion vectors reproject the history with the camera of the previous frame
+    TemporalAA temporalAA;
+    temporalAA.init(SCR_WIDTH, SCR_HEIGHT);
+    // (the history of the first frame is invalid anyway)
+    glm::mat4 previousViewProjection(1.0f);
+    // the projection matrix is only computed once (note: we're not using zoom anymore by changing the FoV)
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, CAMERA_NEAR_PLANE, 100.0f);
 
     // --------------------------------------------------------------------------------
     // configure depth map FBO
@@ -154,7 +345,7 @@ int main()
     // create depth texture
     GLuint depthCubemap;
     glGenTextures(1, &depthCubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
     for (GLuint i = 0; i < 6; ++i) {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT,
             SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
@@ -165,82 +356,54 @@ int main()
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
     // attach depth texture as FBO's depth buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+    glState().bindFramebuffer(depthMapFBO);
     glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemap, 0);
     glDrawBuffer(GL_NONE);
     glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState().bindFramebuffer(0);
 
     // --------------------------------------------------------------------------------
-    // set up floating point framebuffer to render scene to
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    // create a color attachment texture
-    unsigned int textureColorBuffers[2];
-    glGenTextures(2, textureColorBuffers);
-    for (unsigned int i = 0; i < 2; i++) {
-        glBindTexture(GL_TEXTURE_2D, textureColorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // attach texture to framebuffer
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textureColorBuffers[i], 0);
-    }
-    // create a renderbuffer object for depth and stencil attachment (we won't be sampling these)
-    unsigned int rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT); // use a single renderbuffer object for both a depth AND stencil buffer.
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo); // now actually attach it
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering 
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-    // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
+    // the floating point targets of the scene, the blur and the IBL capture are taken from the pool when a pass
+    // needs them and handed back when it is done, so targets whose lifetimes don't overlap share memory
+    RenderTargetPool renderTargets;
+    // the passes of the frame, declared every frame with the resources they use
+    RenderGraph frameGraph(renderTargets);
+    // the benchmark records the pass times of every measured frame
+    frameGraph.keepMeasuredFrames = benchmarkMode;
 
     // --------------------------------------------------------------------------------
-    // setup framebuffer
+    // setup framebuffer, one depth target serves all captures: attachments may differ in size, the render area
+    // is the smallest of them
     unsigned int captureFBO;
-    unsigned int captureRBO;
     glGenFramebuffers(1, &captureFBO);
-    glGenRenderbuffers(1, &captureRBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
+    GLuint captureDepth = renderTargets.acquire(GL_DEPTH_COMPONENT24, 512, 512, GL_NEAREST);
+    glState().bindFramebuffer(captureFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, captureDepth, 0);
+
+    // the benchmark renders its output offscreen at SCR_WIDTH x SCR_HEIGHT: its window is hidden, so the pixels of
+    // the back buffer aren't guaranteed, and a virtual display may clamp it to a smaller size. The frames are
+    // read from there for the golden images and copied to the window.
+    GLuint outputFBO = 0, outputTexture = 0;
+    if (benchmarkMode) {
+        outputTexture = renderTargets.acquire(GL_SRGB8_ALPHA8, SCR_WIDTH, SCR_HEIGHT);
+        vector<GLuint> outputColors(1, outputTexture);
+        // the scene pass without hdr depth tests against the output target
+        outputFBO = renderTargets.framebuffer(outputColors, renderTargets.acquire(GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT, GL_NEAREST));
+    }
+    startupTrace().end(stageTrace);
 
     // --------------------------------------------------------------------------------
     // pbr: load the HDR environment map
-    unsigned int hdrTexture = loadHDRTexture("D:/Projects/Git/AircraftPBS/Resource/HDR/small_empty_house_2k.hdr", true);
+    unsigned int environmentTrace = startupTrace().begin("wait for HDR decode");
+    jobSystem().wait(environmentDecode);
+    startupTrace().end(environmentTrace);
+    unsigned int hdrTexture = loadHDRTexture(environmentImage);
 
     // setup cubemap to render to and attach to framebuffer
+    unsigned int bakeTrace = startupTrace().begin("equirectangular to cubemap");
     unsigned int envCubemap;
     glGenTextures(1, &envCubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
     for (unsigned int i = 0; i < 6; ++i) {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
     }
@@ -266,10 +429,10 @@ int main()
     equirectangularToCubemapShader.use();
     equirectangularToCubemapShader.setIntUniform("equirectangularMap", 0);
     equirectangularToCubemapShader.setMat4Uniform("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, hdrTexture);
-    glViewport(0, 0, 512, 512); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glState().activeTexture(GL_TEXTURE0);
+    glState().bindTexture(GL_TEXTURE_2D, hdrTexture);
+    glState().viewport(0, 0, 512, 512); // don't forget to configure the viewport to the capture dimensions.
+    glState().bindFramebuffer(captureFBO);
     for (unsigned int i = 0; i < 6; ++i)
     {
         equirectangularToCubemapShader.setMat4Uniform("view", captureViews[i]);
@@ -278,17 +441,19 @@ int main()
 
         renderCube();
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState().bindFramebuffer(0);
 
     // then let OpenGL generate mipmaps from first mip face (combatting visible dots artifact)
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
     glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    startupTrace().end(bakeTrace);
 
     // --------------------------------------------------------------------------------
     // create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
+    bakeTrace = startupTrace().begin("irradiance convolution");
     unsigned int irradianceMap;
     glGenTextures(1, &irradianceMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
     for (unsigned int i = 0; i < 6; ++i)
     {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
@@ -299,19 +464,15 @@ int main()
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
-
     // solve diffuse integral by convolution to create an irradiance (cube)map.
     irradianceShader.use();
     irradianceShader.setIntUniform("environmentMap", 0);
     irradianceShader.setMat4Uniform("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glState().activeTexture(GL_TEXTURE0);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 
-    glViewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glState().viewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
+    glState().bindFramebuffer(captureFBO);
     for (unsigned int i = 0; i < 6; ++i)
     {
         irradianceShader.setMat4Uniform("view", captureViews[i]);
@@ -320,13 +481,15 @@ int main()
 
         renderCube();
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState().bindFramebuffer(0);
+    startupTrace().end(bakeTrace);
 
     // --------------------------------------------------------------------------------
     // create a pre-filter cubemap, and re-scale capture FBO to pre-filter scale.
+    bakeTrace = startupTrace().begin("prefilter");
     unsigned int prefilterMap;
     glGenTextures(1, &prefilterMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
     for (unsigned int i = 0; i < 6; ++i)
     {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, nullptr);
@@ -343,19 +506,16 @@ int main()
     prefilterShader.use();
     prefilterShader.setIntUniform("environmentMap", 0);
     prefilterShader.setMat4Uniform("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glState().activeTexture(GL_TEXTURE0);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glState().bindFramebuffer(captureFBO);
     unsigned int maxMipLevels = 5;
     for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
     {
-        // reisze framebuffer according to mip-level size.
         unsigned int mipWidth = static_cast<unsigned int>(128 * std::pow(0.5, mip));
         unsigned int mipHeight = static_cast<unsigned int>(128 * std::pow(0.5, mip));
-        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-        glViewport(0, 0, mipWidth, mipHeight);
+        glState().viewport(0, 0, mipWidth, mipHeight);
 
         float roughness = (float)mip / (float)(maxMipLevels - 1);
         prefilterShader.setFloatUniform("roughness", roughness);
@@ -368,15 +528,17 @@ int main()
             renderCube();
         }
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState().bindFramebuffer(0);
+    startupTrace().end(bakeTrace);
 
     // --------------------------------------------------------------------------------
     // generate a 2D LUT from the BRDF equations used.
+    bakeTrace = startupTrace().begin("BRDF LUT");
     unsigned int brdfLUTTexture;
     glGenTextures(1, &brdfLUTTexture);
 
     // pre-allocate enough memory for the LUT texture.
-    glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
+    glState().bindTexture(GL_TEXTURE_2D, brdfLUTTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 512, 512, 0, GL_RG, GL_FLOAT, 0);
     // be sure to set wrapping mode to GL_CLAMP_TO_EDGE
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -385,40 +547,39 @@ int main()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     // then re-configure capture framebuffer object and render screen-space quad with BRDF shader.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
+    glState().bindFramebuffer(captureFBO);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
 
-    glViewport(0, 0, 512, 512);
+    glState().viewport(0, 0, 512, 512);
     brdfShader.use();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     renderQuad();
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState().bindFramebuffer(0);
+    // the captures are done, the pool frees the depth once no pass asked for it for a while
+    glState().deleteFramebuffer(captureFBO);
+    renderTargets.release(captureDepth);
+    startupTrace().end(bakeTrace);
 
     // --------------------------------------------------------------------------------
-    pbrShader.use();
-    pbrShader.setIntUniform("shadowMap", 8);
-    pbrShader.setIntUniform("irradianceMap", 9);
-    pbrShader.setIntUniform("prefilterMap", 10);
-    pbrShader.setIntUniform("brdfLUT", 11);
-    // point light
-    pbrShader.setVec3Uniform("pointLights[0].color", 5.0f);
-
     blurShader.use();
     blurShader.setIntUniform("image", 0);
-    bloomFinalShader.use();
-    bloomFinalShader.setIntUniform("scene", 0);
-    bloomFinalShader.setIntUniform("bloomBlur", 1);
+    postProcess.init();
 
     skyboxShader.use();
     skyboxShader.setIntUniform("environmentMap", 0);
-    skyboxShader.setMat4Uniform("projection", projection);
 
     // uncomment this call to draw in wireframe polygons.
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+    // stalls of the texture ring already shown by the profiler
+    unsigned int reportedTextureStalls = 0;
+    // scenarios whose last frame didn't match the golden image
+    unsigned int goldenFailures = 0;
+    // the first frame is the last scope of the startup, the report follows once its GPU times arrived
+    unsigned int firstFrameTrace = startupTrace().begin("first frame");
+    bool startupReported = false;
+
     // render loop: keep drawing images and handling user input until the program has been explicitly told to stop
     while (!glfwWindowShouldClose(window)) // checks if GLFW has been instructed to close. If so, the function returns true and the render loop stops running, after which we can close the application
     {
@@ -426,12 +587,34 @@ int main()
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
-
-        // input
-        processInput(window);
+        // the light moves with the scene time, in the benchmark it advances by a fixed step every frame
+        float sceneTime = currentFrame;
+
+        if (benchmarkMode) {
+            benchmark.beginFrame();
+            const BenchmarkScenario& scenario = benchmark.scenario();
+            if (benchmark.starting()) {
+                shadows = scenario.shadows;
+                parallax = scenario.parallax;
+                bloom = scenario.bloom;
+                hdr = scenario.hdr;
+                // the resolution must not follow the measured times, and the history is of the previous scenario
+                dynamicResolution = false;
+                temporalAA.invalidate();
+            }
+            deltaTime = benchmark.timeStep;
+            sceneTime = benchmark.time();
+            CameraKey cameraKey = benchmark.camera();
+            camera.LookAt(cameraKey.position, cameraKey.target);
+        }
+        else {
+            // input
+            processInput(window);
+        }
+        shaderWatcher.update();
 
         // move light position over time
-        glm::vec3 lightPos(static_cast<float>(cos(glfwGetTime() * 0.5) * 10.0)+10.0, 0.0f, static_cast<float>(sin(glfwGetTime() * 0.5) * 10.0)-55.0);
+        glm::vec3 lightPos(static_cast<float>(cos(sceneTime * 0.5) * 10.0)+10.0, 0.0f, static_cast<float>(sin(sceneTime * 0.5) * 10.0)-55.0);
 
         //// bind to framebuffer and draw scene as we normally would to color texture 
         //glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
@@ -461,66 +644,313 @@ int main()
         shadowTransforms.push_back(shadowProj *
             glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0, 0.0)));
 
+        // queue the draw calls of the shadow and the main pass, culled against the camera and the cubemap faces
+        // ---------------------------------------------------------------------------------------------------------
+        Frustum cameraFrustum(projection * camera.GetViewMatrix());
+        Frustum shadowFrusta[6];
+        for (unsigned int i = 0; i < 6; ++i)
+            shadowFrusta[i].setMatrix(shadowTransforms[i]);
+        aircraftLODs.update(); // only subtrees with a changed local transform are recomputed
+        occlusionCuller.beginFrame();
+        // toggling shadows or parallax switches to another variant of the pbs shader, the variants are picked
+        // here on the GL thread, the jobs only look them up. A new variant compiles while the closest ready one
+        // is drawn.
+        unsigned int sceneFeatures = (shadows ? SHADER_SHADOWS : 0) | (parallax ? SHADER_PARALLAX : 0);
+        for (unsigned int i = 0; i < aircraftLODs.levels.size(); ++i) {
+            aircraftLODs.levels[i]->PrepareShaders(depthShaders, 0);
+            aircraftLODs.levels[i]->PrepareShaders(pbrShaders, sceneFeatures);
+        }
+        // the instances are split into contiguous ranges, one command list each, recorded and sorted on the job system
+        const unsigned int instanceCount = FLEET_ROWS * FLEET_COLUMNS;
+        aircraftLODs.reserveInstances(instanceCount);
+        commandLists.resize(std::min(instanceCount, jobSystem().workerCount() + 1));
+        unsigned int listCount = static_cast<unsigned int>(commandLists.size());
+        auto recordCommands = [&](unsigned int list) {
+            CommandList& commands = commandLists[list];
+            commands.shadowQueue.clear();
+            commands.sceneQueue.clear();
+            commands.occlusion.clear();
+            for (unsigned int instance = instanceCount * list / listCount; instance < instanceCount * (list + 1) / listCount; ++instance) {
+                unsigned int row = instance / FLEET_COLUMNS, column = instance % FLEET_COLUMNS;
+                glm::mat4 model = glm::mat4(1.0);
+                model = glm::translate(model, glm::vec3(25.0f + column * FLEET_SPACING, 0.0f, -25.0f - row * FLEET_SPACING));
+                model = glm::rotate(model, glm::radians(-60.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+                // the shadow pass uses the level seen by the camera, so the aircraft doesn't shadow itself with a different mesh
+                Model& aircraft = aircraftLODs.select(instance, model, camera.Position, projection[1][1]);
+                unsigned int level = aircraftLODs.levelOf(instance);
+                aircraft.Submit(commands.shadowQueue, PASS_SHADOW, depthShaders, 0, model, lightPos, shadowFrusta, 6);
+                // every level of every instance has its own occlusion ids, a new level starts without a result
+                unsigned int firstObjectID = (instance * static_cast<unsigned int>(aircraftLODs.levels.size()) + level) * aircraftLODs.maxMeshCount();
+                aircraft.Submit(commands.sceneQueue, PASS_OPAQUE, pbrShaders, sceneFeatures, model, camera.Position, &cameraFrustum, 1,
+                    &occlusionCuller, firstObjectID, &commands.occlusion);
+            }
+            commands.shadowQueue.sort();
+            commands.sceneQueue.sort();
+        };
+        vector<JobSystem::JobHandle> recordJobs;
+        for (unsigned int list = 0; list < listCount; ++list)
+            recordJobs.push_back(jobSystem().submit([&recordCommands, list]() { recordCommands(list); }));
+        // render light source (simply re-renders a smaller plane at the light's position for debugging/visualization)
+        glm::mat4 lightModel = glm::mat4(1.0);
+        lightModel = glm::translate(lightModel, lightPos);
+        lightModel = glm::scale(lightModel, glm::vec3(0.5f));
+        shadowQueue.clear();
+        sceneQueue.clear();
+        sceneQueue.submit(PASS_OPAQUE, lightShader, renderLight, lightModel, camera.Position);
+        // once all lists are recorded, the shadow and the scene lists are merged at the same time. The lists are
+        // merged in a fixed order, so the frame doesn't depend on the timing of the jobs.
+        JobSystem::JobHandle shadowMerge = jobSystem().submit([&]() {
+            for (unsigned int i = 0; i < listCount; ++i)
+                shadowQueue.merge(commandLists[i].shadowQueue);
+        }, recordJobs);
+        JobSystem::JobHandle sceneMerge = jobSystem().submit([&]() {
+            for (unsigned int i = 0; i < listCount; ++i)
+                sceneQueue.merge(commandLists[i].sceneQueue);
+        }, recordJobs);
+        jobSystem().wait(shadowMerge);
+        jobSystem().wait(sceneMerge);
+        for (unsigned int i = 0; i < listCount; ++i)
+            occlusionCuller.addCandidates(commandLists[i].occlusion);
+        for (unsigned int instance = 0; instance < instanceCount; ++instance)
+            profiler().addCounter("lod" + to_string(aircraftLODs.levelOf(instance)), 1);
+
+        // the resolution of the scene follows the measured GPU time, the default framebuffer can't be upscaled
+        gpuTimer.begin();
+        resolution.enabled = dynamicResolution && hdr;
+        // the timer's result only changes every few frames, the controller must only see each one once
+        if (gpuTimer.fresh || !resolution.enabled)
+            resolution.update(gpuTimer.milliseconds);
+        renderWidth = hdr ? resolution.scaled(SCR_WIDTH) : outputWidth;
+        renderHeight = hdr ? resolution.scaled(SCR_HEIGHT) : outputHeight;
+        glm::vec2 renderScale(renderWidth / (float)SCR_WIDTH, renderHeight / (float)SCR_HEIGHT);
+
+        // temporal anti-aliasing renders every frame with a different sub-pixel offset, it needs the hdr targets too
+        bool temporalAntiAliasing = taa && hdr;
+        glm::vec2 jitter(0.0f);
+        if (temporalAntiAliasing)
+            jitter = temporalAA.nextJitter(renderWidth, renderHeight);
+        else
+            temporalAA.invalidate();
+
+        // upload the uniforms of the whole frame at once
+        // ----------------------------------------------
+        FrameUniforms frame;
+        frame.projection = TemporalAA::jitterProjection(projection, jitter);
+        frame.view = camera.GetViewMatrix();
+        for (unsigned int i = 0; i < 6; ++i)
+            frame.shadowMatrices[i] = shadowTransforms[i];
+        frame.viewPos = glm::vec4(camera.Position, 1.0f);
+        frame.lightPos = glm::vec4(lightPos, 1.0f);
+        frame.lightColor = glm::vec4(glm::vec3(5.0f), 1.0f);
+        frame.params = glm::vec4(far_plane, height_scale, 0.0f, 0.0f);
+        frame.shadows = shadows; // enable/disable shadows by pressing 'O'
+        frame.parallax = parallax;
+        frame.padding[0] = frame.padding[1] = 0;
+        frame.previousViewProjection = previousViewProjection;
+        frame.jitter = glm::vec4(jitter, 0.0f, 0.0f);
+        previousViewProjection = projection * camera.GetViewMatrix();
+        frameUploads.begin();
+        GLintptr frameOffset = frameUploads.push(&frame, sizeof(FrameUniforms));
+        shadowQueue.packObjects(frameUploads);
+        sceneQueue.packObjects(frameUploads);
+        frameUploads.upload();
+        frameUploads.bindRange(FRAME_UNIFORM_BINDING, frameOffset, sizeof(FrameUniforms));
+
+        // declare the passes of the frame, the graph culls what isn't needed, orders the rest and takes the
+        // transient targets from the pool for as long as they are used
+        // --------------------------------------------------------------------------------------------------------
+        postProcess.setStage(POST_BLOOM, bloom);
+        postProcess.setStage(POST_AUTO_EXPOSURE, autoExposure);
+        postProcess.setStage(POST_GAMMA, gammaEnabled);
+        postProcess.setStage(POST_SHARPEN, renderWidth < outputWidth);
+        postProcess.exposure = exposure;
+        postProcess.renderScale = renderScale;
+        postProcess.bloomScale = renderScale;
+        frameGraph.beginFrame();
+        RenderResource backbuffer = frameGraph.importFramebuffer("backbuffer", outputFBO, outputTexture, true);
+        RenderResource shadowMap = frameGraph.importFramebuffer("shadowMap", depthMapFBO, depthCubemap, false);
+
         // 1. render scene to depth cubemap
         // --------------------------------
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        depthShader.use();
-        for (unsigned int i = 0; i < 6; ++i)
-            depthShader.setMat4Uniform("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
-        depthShader.setFloatUniform("far_plane", far_plane);
-        depthShader.setVec3Uniform("lightPos", lightPos);
-        glm::mat4 model = glm::mat4(1.0);
-        model = glm::translate(model, glm::vec3(25.0f, 0.0f, -25.0f));
-        model = glm::rotate(model, glm::radians(-60.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        depthShader.setMat4Uniform("model", model);
-        myModel.Draw(depthShader);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        frameGraph.addPass("shadow", [&](RenderGraph&) {
+            glClear(GL_DEPTH_BUFFER_BIT);
+            shadowQueue.execute(PASS_SHADOW, frameUploads);
+        }).target(shadowMap).viewport(SHADOW_WIDTH, SHADOW_HEIGHT);
 
         // 2. render scene as normal with shadow mapping (using depth cubemap)
         // --------------------------------------------------------------
         if (hdr) { //render scene into floating point framebuffer
-            glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-            renderScene(pbrShader, lightShader, skyboxShader, myModel, uboMatrices, depthCubemap, far_plane, lightPos, envCubemap, irradianceMap, prefilterMap, brdfLUTTexture);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            RenderResource sceneColor = frameGraph.createTexture("sceneColor", GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT);
+            RenderResource brightColor = frameGraph.createTexture("brightColor", GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT);
+            // the motion vectors of the temporal anti-aliasing, in texture coordinates of the screen
+            RenderResource velocity = frameGraph.createTexture("velocity", GL_RG16F, SCR_WIDTH, SCR_HEIGHT, GL_NEAREST);
+            // the depth is sampled to build the Hi-Z pyramid of the occlusion culling
+            RenderResource depthStencil = frameGraph.createTexture("depthStencil", GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT, GL_NEAREST);
+            frameGraph.addPass("scene", [&](RenderGraph&) {
+                renderScene(skyboxShader, occlusionCuller, depthCubemap, envCubemap, irradianceMap, prefilterMap, brdfLUTTexture);
+            }).read(shadowMap).color(sceneColor).color(brightColor).color(velocity).depth(depthStencil).viewport(renderWidth, renderHeight);
+
+            // test the meshes against this frame's depth, the results cull the next frames
+            RenderResource hiZ = frameGraph.importResource("hiZ", false);
+            RenderResource occlusionResults = frameGraph.importResource("occlusionResults", true);
+            frameGraph.addPass("hiZ", [&](RenderGraph& graph) {
+                occlusionCuller.buildHiZ(graph.texture(depthStencil), renderQuad);
+            }).read(depthStencil).write(hiZ);
+            frameGraph.addPass("occlusionTest", [&](RenderGraph&) {
+                occlusionCuller.test(projection * camera.GetViewMatrix(), frameUploads, renderScale);
+            }).read(hiZ).write(occlusionResults);
+
+            RenderResource adaptedExposure = frameGraph.importResource("exposure", true);
+            if (autoExposure) {
+                frameGraph.addPass("autoExposure", [&](RenderGraph& graph) {
+                    autoExposureStage.update(graph.texture(sceneColor), renderScale, deltaTime, renderQuad);
+                }).read(sceneColor).write(adaptedExposure);
+            }
 
-            // 3. blur bright fragments with two-pass Gaussian Blur 
+            // 3. blur bright fragments with two-pass Gaussian Blur, culled unless the bloom stage reads it. Every
+            // pass writes a new target, the pool hands out the ones of the passes before the previous one.
             // --------------------------------------------------
-            bool horizontal = true, first_iteration = true;
-            unsigned int amount = 10;
-            blurShader.use();
-            for (unsigned int i = 0; i < amount; i++) {
-                glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-                blurShader.setIntUniform("horizontal", horizontal);
-                glBindTexture(GL_TEXTURE_2D, first_iteration ? textureColorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
-                renderQuad();
+            RenderResource bloomBlur = brightColor;
+            bool horizontal = true;
+            for (unsigned int i = 0; i < 10; i++) {
+                RenderResource source = bloomBlur;
+                bloomBlur = frameGraph.createTexture("blur", GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT);
+                frameGraph.addPass("blur", [&, source, horizontal](RenderGraph& graph) {
+                    blurShader.use();
+                    blurShader.setVec2Uniform("renderScale", renderScale);
+                    blurShader.setIntUniform("horizontal", horizontal);
+                    glState().bindTexture(0, GL_TEXTURE_2D, graph.texture(source));
+                    glState().activeTexture(GL_TEXTURE0);
+                    renderQuad();
+                }).read(source).color(bloomBlur).viewport(renderWidth, renderHeight);
                 horizontal = !horizontal;
-                if (first_iteration)
-                    first_iteration = false;
             }
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-            // 4. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
+            // 4. resolve the jittered scene against the history, the result has the full size of the targets
             // --------------------------------------------------------------------------------------------------------------------------
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            bloomFinalShader.use();
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, textureColorBuffers[0]);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-            bloomFinalShader.setIntUniform("bloom", bloom);
-            bloomFinalShader.setFloatUniform("exposure", exposure);
-            renderQuad();
+            GLuint sceneTexture = 0;
+            RenderResource resolvedScene = sceneColor;
+            if (temporalAntiAliasing) {
+                resolvedScene = frameGraph.importResource("taaHistory", true);
+                frameGraph.addPass("taa", [&](RenderGraph& graph) {
+                    sceneTexture = temporalAA.resolve(graph.texture(sceneColor), graph.texture(velocity), graph.texture(depthStencil), renderScale, renderQuad);
+                }).read(sceneColor).read(velocity).read(depthStencil).write(resolvedScene);
+                postProcess.renderScale = glm::vec2(1.0f);
+            }
+
+            // 5. bloom composite, tonemapping, gamma and the other enabled stages in one pass to the default framebuffer
+            // --------------------------------------------------------------------------------------------------------------------------
+            RenderGraph::PassBuilder composite = frameGraph.addPass("postProcess", [&](RenderGraph& graph) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                GLuint scene = temporalAntiAliasing ? sceneTexture : graph.texture(sceneColor);
+                GLuint bloomTexture = postProcess.hasStage(POST_BLOOM) ? graph.texture(bloomBlur) : 0;
+                postProcess.apply(scene, bloomTexture, autoExposureStage.exposureTexture(), renderQuad);
+            });
+            composite.read(resolvedScene).target(backbuffer).viewport(outputWidth, outputHeight);
+            if (postProcess.hasStage(POST_BLOOM))
+                composite.read(bloomBlur);
+            if (postProcess.hasStage(POST_AUTO_EXPOSURE))
+                composite.read(adaptedExposure);
+            frameGraph.execute();
         }
         else {
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            renderScene(pbrShader, lightShader, skyboxShader, myModel, uboMatrices, depthCubemap, far_plane, lightPos, envCubemap, irradianceMap, prefilterMap, brdfLUTTexture);
+            frameGraph.addPass("scene", [&](RenderGraph&) {
+                renderScene(skyboxShader, occlusionCuller, depthCubemap, envCubemap, irradianceMap, prefilterMap, brdfLUTTexture);
+            }).read(shadowMap).target(backbuffer).viewport(renderWidth, renderHeight);
+            frameGraph.execute();
+            // the default framebuffer's depth can't be sampled, so there is nothing to test against
+            occlusionCuller.invalidate();
+        }
+        if (dumpRenderGraph) {
+            frameGraph.dump(cout);
+            dumpRenderGraph = false;
+        }
+        gpuTimer.end();
+        // the GPU may only overwrite this frame's uniforms once it is done with them
+        frameUploads.end();
+
+        // report the state changes of the frame
+        glState().newFrame();
+        renderTargets.endFrame();
+        profiler().setCounter("glCalls", glState().lastFrameIssuedCalls);
+        profiler().setCounter("glRedundant", glState().lastFrameRedundantCalls);
+        profiler().setCounter("uploadStalls", frameUploads.lastFrameStalls);
+        profiler().setCounter("uploadKB", frameUploads.lastFrameBytes / 1024.0);
+        // the texture ring ends a frame per uploaded band, its stalls are counted since the last report
+        profiler().setCounter("textureUploadStalls", textureUploads().stalls - reportedTextureStalls);
+        reportedTextureStalls = textureUploads().stalls;
+        profiler().setCounter("nodeUpdates", aircraftLODs.updatedNodes);
+        profiler().setCounter("sceneDraws", sceneQueue.items.size());
+        profiler().setCounter("sceneCulled", sceneQueue.culledItems);
+        profiler().setCounter("occlusionTested", occlusionCuller.testedItems);
+        profiler().setCounter("occluded", occlusionCuller.occludedItems);
+        profiler().setCounter("shadowDraws", shadowQueue.items.size());
+        profiler().setCounter("shadowCulled", shadowQueue.culledItems);
+        profiler().setCounter("shaderVariants", pbrShaders.variantCount());
+        profiler().setCounter("gpuMs", gpuTimer.milliseconds);
+        profiler().setCounter("renderScale", resolution.scale);
+        profiler().setCounter("targetMB", renderTargets.allocatedBytes / (1024.0 * 1024.0));
+        profiler().setCounter("targetPeakMB", renderTargets.lastFrameBytes / (1024.0 * 1024.0));
+        profiler().setCounter("targetAllocations", renderTargets.lastFrameAllocations);
+        profiler().setCounter("passes", frameGraph.executedPasses);
+        profiler().setCounter("passesCulled", frameGraph.culledPasses);
+        profiler().setCounter("commandLists", commandLists.size());
+        // what every worker (and the GL thread while it waited) ran during the frame
+        unsigned int jobSteals = 0;
+        for (unsigned int i = 0; i <= jobSystem().workerCount(); ++i) {
+            JobSystem::WorkerStats stats = jobSystem().takeStats(i);
+            string worker = i < jobSystem().workerCount() ? "worker" + to_string(i) : "glThread";
+            profiler().setCounter(worker + "Jobs", stats.jobs);
+            profiler().setCounter(worker + "Ms", stats.busyMilliseconds);
+            jobSteals += stats.steals;
+        }
+        profiler().setCounter("jobSteals", jobSteals);
+        profiler().endFrame(deltaTime);
+
+        if (benchmarkMode) {
+            // the pass times arrive a few frames late, sometimes several frames at once, each is recorded for the
+            // frame it measured
+            for (unsigned int i = 0; i < frameGraph.measuredFrames.size(); ++i) {
+                const RenderGraph::FrameTimes& times = frameGraph.measuredFrames[i];
+                unsigned int framesAgo = frameGraph.frames - times.frame;
+                double gpuMilliseconds = 0.0;
+                for (unsigned int j = 0; j < times.passMilliseconds.size(); ++j) {
+                    benchmark.record("gpu." + times.passMilliseconds[j].first, times.passMilliseconds[j].second, framesAgo);
+                    gpuMilliseconds += times.passMilliseconds[j].second;
+                }
+                benchmark.record("gpu", gpuMilliseconds, framesAgo);
+            }
+            frameGraph.measuredFrames.clear();
+            bool goldenFrame = !goldenDirectory.empty() && benchmark.ending();
+            string scenarioName = benchmark.scenario().name;
+            benchmark.endFrame();
+            if (goldenFrame) {
+                // the output of the frame (after the frame was timed), as stored, without a conversion from sRGB
+                glState().bindFramebuffer(outputFBO);
+                glState().setFramebufferSRGB(false);
+                glReadBuffer(GL_COLOR_ATTACHMENT0);
+                if (!checkGoldenImage(readFramebuffer(outputWidth, outputHeight), scenarioName, goldenDirectory, updateGolden, benchmarkOutput))
+                    goldenFailures++;
+            }
+            // show the output in the window, scaled to whatever size it got
+            int windowWidth = 0, windowHeight = 0;
+            glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+            glState().bindFramebuffer(0);
+            glState().bindReadFramebuffer(outputFBO);
+            glBlitFramebuffer(0, 0, outputWidth, outputHeight, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            if (benchmark.done()) {
+                benchmark.writeResults(benchmarkOutput);
+                glfwSetWindowShouldClose(window, true);
+            }
         }
 
         // swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // swap the color buffer that is used to render to during this render iteration and show it as output to the screen
+        startupTrace().end(firstFrameTrace);
+        firstFrameTrace = StartupTrace::NO_EVENT;
         glfwSwapBuffers(window);
+        if (!startupReported)
+            startupReported = startupTrace().report(cout, tracePath);
         // checks if any events are triggered (like keyboard input or mouse movement events), updates the window state, and calls the corresponding functions (which we can register via callback methods)
         glfwPollEvents();
     }
@@ -528,7 +958,37 @@ int main()
     // clean/delete all of GLFW's resources allocated
     glfwTerminate();
 
-    return 0;
+    return goldenFailures > 0 ? 1 : 0;
+}
+
+// compares the last frame of a benchmark scenario with its golden image, or replaces the golden image. A frame
+// that differs is written to <outputPrefix>.<scenario>.ppm, with its error map in <outputPrefix>.<scenario>.diff.ppm.
+bool checkGoldenImage(const RGBImage& image, const string& scenario, const string& goldenDirectory, bool updateGolden, const string& outputPrefix)
+{
+    string goldenPath = goldenDirectory + "/" + scenario + ".ppm";
+    if (updateGolden) {
+        if (!writePPM(goldenPath, image)) {
+            cout << "ERROR::GOLDEN:: failed to write " << goldenPath << endl;
+            return false;
+        }
+        cout << "GOLDEN:: " << scenario << " stored in " << goldenPath << endl;
+        return true;
+    }
+    RGBImage golden;
+    if (!readPPM(goldenPath, golden)) {
+        cout << "ERROR::GOLDEN:: failed to read " << goldenPath << endl;
+        return false;
+    }
+    ImageTolerance tolerance;
+    ImageDifference difference = compareImages(golden, image, tolerance);
+    bool passed = difference.passes(tolerance);
+    cout << "GOLDEN:: " << scenario << (passed ? " matches" : " DIFFERS") << ", mean error " << difference.meanError
+        << ", max error " << difference.maxError << ", " << difference.failingShare * 100.0 << "% of the pixels over " << tolerance.pixelError << endl;
+    if (!passed) {
+        writePPM(outputPrefix + "." + scenario + ".ppm", image);
+        writePPM(outputPrefix + "." + scenario + ".diff.ppm", difference.errorMap);
+    }
+    return passed;
 }
 
 // process input : query GLFW whether relevant keys are pressed / released this frame and react accordingly
@@ -603,7 +1063,7 @@ void processInput(GLFWwindow* window) {
         hdrKeyPressed = false;
     }
 
-    // Change parallax height scale
+    // Change the exposure (the compensation with auto exposure)
     if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS) {
         exposure -= 0.5 * deltaTime;
     }
@@ -611,6 +1071,36 @@ void processInput(GLFWwindow* window) {
         exposure += 0.5 * deltaTime;
     }
 
+    if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS && !autoExposureKeyPressed)
+    {
+        autoExposure = !autoExposure;
+        autoExposureKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_X) == GLFW_RELEASE)
+    {
+        autoExposureKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !dynamicResolutionKeyPressed)
+    {
+        dynamicResolution = !dynamicResolution;
+        dynamicResolutionKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE)
+    {
+        dynamicResolutionKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS && !taaKeyPressed)
+    {
+        taa = !taa;
+        taaKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_RELEASE)
+    {
+        taaKeyPressed = false;
+    }
+
     if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !bloomKeyPressed)
     {
         bloom = !bloom;
@@ -620,12 +1110,38 @@ void processInput(GLFWwindow* window) {
     {
         bloomKeyPressed = false;
     }
+
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS && !dumpRenderGraphKeyPressed)
+    {
+        dumpRenderGraph = true;
+        dumpRenderGraphKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_RELEASE)
+    {
+        dumpRenderGraphKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS && !profilerKeyPressed)
+    {
+        profiler().enabled = !profiler().enabled;
+        profilerKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_RELEASE)
+    {
+        profilerKeyPressed = false;
+    }
 }
 
 // a callback function on the window that gets called each time the window is resized
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height); // tell OpenGL the size of the rendering window with respect to that of the window
+    glState().viewport(0, 0, width, height); // tell OpenGL the size of the rendering window with respect to that of the window
+    // the scene is upscaled to the new size in the post processing pass (minimized windows have no size). The
+    // benchmark's output keeps its size, it is rendered offscreen.
+    if (width > 0 && height > 0 && !benchmarkMode) {
+        outputWidth = width;
+        outputHeight = height;
+    }
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -692,7 +1208,7 @@ unsigned int loadTexture(char const* path, bool backToLinear) {
             }
         }
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        glState().bindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -712,43 +1228,24 @@ unsigned int loadTexture(char const* path, bool backToLinear) {
     return textureID;
 }
 
-unsigned int loadHDRTexture(char const* path, bool backToLinear) {
-    stbi_set_flip_vertically_on_load(true);
+// decodes an hdr image, may run on the job system (the flip only applies to the calling thread)
+void decodeHDRImage(HDRImage& image, char const* path) {
+    TraceScope trace("decode HDR");
+    stbi_set_flip_vertically_on_load_thread(true);
+    image.path = path;
+    image.data = stbi_loadf(path, &image.width, &image.height, &image.components, 3);
+    stbi_set_flip_vertically_on_load_thread(false);
+}
 
+// uploads a decoded hdr image as an RGB16F texture and frees the image
+unsigned int loadHDRTexture(HDRImage& image) {
+    TraceScope trace("upload HDR");
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    float* data = stbi_loadf(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        GLenum internalFormat;
-        if (nrComponents == 1) {
-            format = GL_RED;
-            internalFormat = GL_RED;
-        }
-        else if (nrComponents == 3) {
-            format = GL_RGB;
-            if (backToLinear) {
-                internalFormat = GL_SRGB;
-            }
-            else {
-                internalFormat = GL_RGB16F;
-            }
-        }
-        else if (nrComponents == 4) {
-            format = GL_RGBA;
-            if (backToLinear) {
-                internalFormat = GL_SRGB_ALPHA;
-            }
-            else {
-                internalFormat = GL_RGBA;
-            }
-        }
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        //glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, data);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data);
+    if (image.data) {
+        glState().bindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, image.width, image.height, 0, GL_RGB, GL_FLOAT, image.data);
         //glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -756,16 +1253,14 @@ unsigned int loadHDRTexture(char const* path, bool backToLinear) {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        stbi_image_free(data);
+        stbi_image_free(image.data);
+        image.data = nullptr;
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
     }
 
-    stbi_set_flip_vertically_on_load(false);
-
     return textureID;
 }
 
@@ -782,7 +1277,7 @@ unsigned int loadCubemap(vector<std::string> faces)
 {
     unsigned int textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
     int width, height, nrChannels;
     for (unsigned int i = 0; i < faces.size(); i++)
@@ -810,64 +1305,38 @@ unsigned int loadCubemap(vector<std::string> faces)
 
 // renders the 3D scene
 // --------------------
-void renderScene(Shader& lightingShader, Shader& lightShader, Shader& skyboxShader, Model& myModel, int uboMatrices, int depthCubemap, float far_plane, glm::vec3 lightPos, int envCubemap, int irradianceMap, int prefilterMap, int brdfLUT) {
-    // reset viewport
-    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+void renderScene(Shader& skyboxShader, OcclusionCuller& occlusion, int depthCubemap, int envCubemap, int irradianceMap, int prefilterMap, int brdfLUT) {
+    // reset viewport to the part of the targets the scene is rendered to
+    glState().viewport(0, 0, renderWidth, renderHeight);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    lightingShader.use();
-    glm::mat4 view = camera.GetViewMatrix();
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    glm::mat4 model = glm::mat4(1.0);
-    model = glm::translate(model, glm::vec3(25.0f, 0.0f, -25.0f));
-    model = glm::rotate(model, glm::radians(-60.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    lightingShader.setMat4Uniform("model", model);
-    glm::mat4 normalMatrix = transpose(inverse(model));
-    lightingShader.setMat4Uniform("normalMatrix", normalMatrix);
-    // set light uniforms
-    lightingShader.setVec3Uniform("viewPos", camera.Position);
-    lightingShader.setVec3Uniform("lightPos", lightPos);
-    lightingShader.setVec3Uniform("pointLights[0].position_world", lightPos);
-    lightingShader.setVec3Uniform("viewPos_world", camera.Position);
-    lightingShader.setIntUniform("shadows", shadows); // enable/disable shadows by pressing 'S'
-    lightingShader.setFloatUniform("far_plane", far_plane);
-    lightingShader.setBoolUniform("parallax", parallax);
-    lightingShader.setFloatUniform("height_scale", height_scale);
-    glActiveTexture(GL_TEXTURE8);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
-    glActiveTexture(GL_TEXTURE9);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-    glActiveTexture(GL_TEXTURE10);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-    glActiveTexture(GL_TEXTURE11);
-    glBindTexture(GL_TEXTURE_2D, brdfLUT);
-    if (gammaEnabled) {
-        glEnable(GL_FRAMEBUFFER_SRGB);
-    }
-    else {
-        glDisable(GL_FRAMEBUFFER_SRGB);
-    }
-    myModel.Draw(lightingShader);
-
-    // render light source (simply re-renders a smaller plane at the light's position for debugging/visualization)
-    lightShader.use();
-    model = glm::mat4(1.0);
-    model = glm::translate(model, lightPos);
-    model = glm::scale(model, glm::vec3(0.5f));
-    lightShader.setMat4Uniform("model", model);
-    renderLight();
+    // camera, light and object uniforms are already uploaded for the frame, only the shadow and IBL maps need binding
+    glState().activeTexture(GL_TEXTURE8);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
+    glState().activeTexture(GL_TEXTURE9);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+    glState().activeTexture(GL_TEXTURE10);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+    glState().activeTexture(GL_TEXTURE11);
+    glState().bindTexture(GL_TEXTURE_2D, brdfLUT);
+    glState().setFramebufferSRGB(gammaEnabled);
+    // draw the queued model and light source sorted by program and material
+    sceneQueue.execute(PASS_OPAQUE, frameUploads);
+    // the meshes the occlusion results culled are tested against the depth drawn so far, and drawn if they
+    // became visible since the results were taken
+    occlusion.testOccluded(camera.Position, CAMERA_NEAR_PLANE);
+    sceneQueue.execute(PASS_OPAQUE, frameUploads, &occlusion, true);
 
     // draw skybox as last
-    glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-    skyboxShader.use();
-    view = glm::mat4(glm::mat3(camera.GetViewMatrix())); // remove translation from the view matrix
-    skyboxShader.setMat4Uniform("view", view);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glState().depthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+    skyboxShader.use(); // the skybox removes the translation from the view matrix of the frame itself
+    glState().activeTexture(GL_TEXTURE0);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
     renderCube();
-    glDepthFunc(GL_LESS); // set depth function back to default
+    glState().depthFunc(GL_LESS); // set depth function back to default
+
+    // blend the meshes with an opacity map back-to-front over everything else
+    sceneQueue.execute(PASS_TRANSLUCENT, frameUploads, &occlusion);
 }
 
 unsigned int lightVAO = 0;
@@ -922,19 +1391,18 @@ void renderLight()
         glGenVertexArrays(1, &lightVAO);
         glGenBuffers(1, &lightVBO);
         // fill buffer
-        glBindBuffer(GL_ARRAY_BUFFER, lightVBO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, lightVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
         // link vertex attributes
-        glBindVertexArray(lightVAO);
+        glState().bindVertexArray(lightVAO);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+        glState().bindVertexArray(0);
     }
     // render Cube
-    glBindVertexArray(lightVAO);
+    glState().bindVertexArray(lightVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
 }
 
 // renderQuad() Renders a 1x1 quad in NDC, best used for framebuffer color targets
@@ -954,17 +1422,16 @@ void renderQuad()
         // Setup plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glState().bindVertexArray(quadVAO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)0);
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
     }
-    glBindVertexArray(quadVAO);
+    glState().bindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }
 
 // renders (and builds at first invocation) a sphere
@@ -1046,8 +1513,8 @@ void renderSphere()
                 data.push_back(uv[i].y);
             }
         }
-        glBindVertexArray(sphereVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glState().bindVertexArray(sphereVAO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, vbo);
         glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
@@ -1060,7 +1527,7 @@ void renderSphere()
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
     }
 
-    glBindVertexArray(sphereVAO);
+    glState().bindVertexArray(sphereVAO);
     glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
 }
 
@@ -1120,16 +1587,15 @@ void renderCube()
         glGenVertexArrays(1, &cubeVAO);
         glGenBuffers(1, &cubeVBO);
         // fill buffer
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, cubeVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
         // link vertex attributes
-        glBindVertexArray(cubeVAO);
+        glState().bindVertexArray(cubeVAO);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glBindVertexArray(0);
+        glState().bindVertexArray(0);
     }
     // render Cube
-    glBindVertexArray(cubeVAO);
+    glState().bindVertexArray(cubeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
 }
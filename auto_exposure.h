@@ -0,0 +1,123 @@
+#ifndef AUTO_EXPOSURE_H
+#define AUTO_EXPOSURE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// Exposure that follows the brightness of the hdr image. The log luminance of the scene is rendered into a small
+// mipmapped texture whose 1x1 level (glGenerateMipmap) is the mean log luminance, the geometric mean of the
+// luminance. GL 3.3 has no compute shaders to build a histogram, the mip chain is the reduction that needs
+// neither. A 1x1 pass then moves the adapted luminance of the previous frame towards it, so the exposure
+// changes smoothly like an eye adapting. All of it stays on the GPU, the tonemapper samples the adapted
+// luminance from exposureTexture() and nothing is read back.
+class AutoExposure
+{
+public:
+    // size of the log luminance texture, a power of two so every level halves exactly
+    static const unsigned int LUMINANCE_SIZE = 256;
+
+    // how fast the adapted luminance approaches the measured one, per second
+    float adaptationSpeed = 1.5f;
+    // the measured luminance is clamped to this range, so a black or a burnt out frame doesn't run away
+    float minLuminance = 0.03f;
+    float maxLuminance = 30.0f;
+
+    AutoExposure() : luminanceShader("bloom_final.vs", "", "luminance.fs"), adaptShader("bloom_final.vs", "", "exposure_adapt.fs") {}
+
+    // creates the textures for an hdr image of the given size
+    void init(unsigned int screenWidth, unsigned int screenHeight) {
+        width = screenWidth;
+        height = screenHeight;
+        levels = 1;
+        while ((LUMINANCE_SIZE >> (levels - 1)) > 1)
+            levels++;
+        glGenTextures(1, &luminanceTexture);
+        glState().bindTexture(GL_TEXTURE_2D, luminanceTexture);
+        for (int level = 0; level < levels; level++)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_R16F, LUMINANCE_SIZE >> level, LUMINANCE_SIZE >> level, 0, GL_RED, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glGenFramebuffers(1, &luminanceFBO);
+        glState().bindFramebuffer(luminanceFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, luminanceTexture, 0);
+
+        // the adapted luminance ping-pongs between two 1x1 textures, 0 marks that nothing was measured yet
+        const float unset = 0.0f;
+        glGenTextures(2, adaptedTextures);
+        glGenFramebuffers(2, adaptedFBOs);
+        for (unsigned int i = 0; i < 2; i++) {
+            glState().bindTexture(GL_TEXTURE_2D, adaptedTextures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, 1, 1, 0, GL_RED, GL_FLOAT, &unset);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glState().bindFramebuffer(adaptedFBOs[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, adaptedTextures[i], 0);
+        }
+        glState().bindFramebuffer(0);
+
+        luminanceShader.use();
+        luminanceShader.setIntUniform("hdrImage", 0);
+        adaptShader.use();
+        adaptShader.setIntUniform("logLuminance", 0);
+        adaptShader.setIntUniform("previousLuminance", 1);
+        adaptShader.setIntUniform("luminanceLevel", levels - 1);
+    }
+
+    // measures the hdr texture and adapts to it, drawQuad draws a full screen quad. The scene covers renderScale
+    // of the texture (see DynamicResolution).
+    void update(GLuint hdrTexture, glm::vec2 renderScale, float deltaTime, void (*drawQuad)()) {
+        // 1. log luminance of the scene, every texel averages a block of the hdr image
+        glState().bindFramebuffer(luminanceFBO);
+        glState().viewport(0, 0, LUMINANCE_SIZE, LUMINANCE_SIZE);
+        luminanceShader.use();
+        luminanceShader.setVec2Uniform("renderScale", renderScale);
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, hdrTexture);
+        drawQuad();
+        glState().bindTexture(GL_TEXTURE_2D, luminanceTexture);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        // 2. move the adapted luminance towards the mean, frame rate independent
+        unsigned int previous = current;
+        current = 1 - current;
+        glState().bindFramebuffer(adaptedFBOs[current]);
+        glState().viewport(0, 0, 1, 1);
+        adaptShader.use();
+        adaptShader.setFloatUniform("adaptation", 1.0f - std::exp(-std::max(deltaTime, 0.0f) * adaptationSpeed));
+        adaptShader.setFloatUniform("minLuminance", minLuminance);
+        adaptShader.setFloatUniform("maxLuminance", maxLuminance);
+        glState().activeTexture(GL_TEXTURE1);
+        glState().bindTexture(GL_TEXTURE_2D, adaptedTextures[previous]);
+        drawQuad();
+
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindFramebuffer(0);
+        glState().viewport(0, 0, width, height);
+    }
+
+    // 1x1 R32F texture with the adapted scene luminance
+    GLuint exposureTexture() const {
+        return adaptedTextures[current];
+    }
+
+private:
+    Shader luminanceShader;
+    Shader adaptShader;
+    unsigned int width = 0, height = 0;
+    int levels = 0;
+    GLuint luminanceTexture = 0, luminanceFBO = 0;
+    GLuint adaptedTextures[2] = {};
+    GLuint adaptedFBOs[2] = {};
+    unsigned int current = 0;
+};
+#endif
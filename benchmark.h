@@ -0,0 +1,326 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// a point of a camera path, the camera is at position looking at target
+struct CameraKey {
+    float time;
+    glm::vec3 position;
+    glm::vec3 target;
+};
+
+// a scripted camera path and the features the frames along it are rendered with
+struct BenchmarkScenario {
+    string name;
+    vector<CameraKey> path;
+    bool shadows = true;
+    bool parallax = false;
+    bool bloom = false;
+    bool hdr = true;
+    // frames rendered at the start of the path before measuring, until shaders, targets, the history of the
+    // temporal anti-aliasing and the adapted exposure settled
+    unsigned int warmupFrames = 60;
+    unsigned int frames = 300;
+
+    // the camera at a time of the path, interpolated linearly between the keys
+    CameraKey cameraAt(float time) const {
+        if (time <= path.front().time)
+            return path.front();
+        for (unsigned int i = 1; i < path.size(); i++) {
+            if (time > path[i].time)
+                continue;
+            const CameraKey& from = path[i - 1];
+            const CameraKey& to = path[i];
+            float t = (time - from.time) / std::max(to.time - from.time, 1e-6f);
+            CameraKey key;
+            key.time = time;
+            key.position = glm::mix(from.position, to.position, t);
+            key.target = glm::mix(from.target, to.target, t);
+            return key;
+        }
+        return path.back();
+    }
+};
+
+// Runs scenarios frame by frame with a fixed time step, so every run renders the same frames whatever the frame
+// rate is, and measures them. Before every frame the application asks for the scene time and the camera, after
+// it records the times of the frame (see record) and calls endFrame. GPU times arrive a few frames late, they
+// are recorded for the frame they were measured in, which may be of an earlier scenario. The results are written
+// per frame as CSV and as a JSON summary of every metric (mean, median, percentiles, deviation).
+class Benchmark
+{
+public:
+    // seconds the scene advances per frame
+    float timeStep = 1.0f / 60.0f;
+    vector<BenchmarkScenario> scenarios;
+
+    // the scenarios of the aircraft scene: the same orbit with every feature on its own, a fly-by from far
+    // away and a close-up for parallax mapping
+    static vector<BenchmarkScenario> defaultScenarios() {
+        const glm::vec3 aircraft(25.0f, 1.0f, -25.0f);
+        vector<CameraKey> orbit;
+        for (unsigned int i = 0; i <= 16; i++) {
+            float angle = glm::radians(360.0f * i / 16.0f);
+            orbit.push_back(key(5.0f * i / 16.0f, aircraft + glm::vec3(cos(angle) * 18.0f, 4.0f, sin(angle) * 18.0f), aircraft));
+        }
+        vector<CameraKey> flyby;
+        flyby.push_back(key(0.0f, glm::vec3(0.0f, 0.0f, 3.0f), aircraft));
+        flyby.push_back(key(3.0f, glm::vec3(35.0f, 2.0f, -12.0f), aircraft));
+        flyby.push_back(key(5.0f, glm::vec3(50.0f, 6.0f, -40.0f), aircraft));
+        vector<CameraKey> closeup;
+        closeup.push_back(key(0.0f, aircraft + glm::vec3(6.0f, 0.5f, 4.0f), aircraft));
+        closeup.push_back(key(5.0f, aircraft + glm::vec3(-6.0f, 0.5f, 4.0f), aircraft));
+
+        vector<BenchmarkScenario> result;
+        result.push_back(scenario("orbit", orbit));
+        result.push_back(scenario("orbitNoShadows", orbit));
+        result.back().shadows = false;
+        result.push_back(scenario("orbitBloom", orbit));
+        result.back().bloom = true;
+        result.push_back(scenario("orbitLDR", orbit));
+        result.back().hdr = false;
+        result.push_back(scenario("closeupParallax", closeup));
+        result.back().parallax = true;
+        result.push_back(scenario("flyby", flyby));
+        return result;
+    }
+
+    // keeps only the scenario of that name, false if there is none
+    bool select(const string& name) {
+        for (unsigned int i = 0; i < scenarios.size(); i++) {
+            if (scenarios[i].name == name) {
+                BenchmarkScenario selected = scenarios[i];
+                scenarios.assign(1, selected);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool done() const {
+        return current >= scenarios.size();
+    }
+
+    const BenchmarkScenario& scenario() const {
+        return scenarios[current];
+    }
+
+    // true in the first frame of a scenario, its features have to be applied
+    bool starting() const {
+        return frame == 0;
+    }
+
+    // true in the last frame of a scenario, the frame golden images are taken of
+    bool ending() const {
+        return frame + 1 == scenario().warmupFrames + scenario().frames;
+    }
+
+    bool warmingUp() const {
+        return frame < scenario().warmupFrames;
+    }
+
+    // time of the current frame on the path, it stays at the start during the warmup
+    float time() const {
+        return warmingUp() ? 0.0f : (frame - scenario().warmupFrames) * timeStep;
+    }
+
+    CameraKey camera() const {
+        return scenario().cameraAt(time());
+    }
+
+    // starts timing the GL thread's work on the frame
+    void beginFrame() {
+        frameStart = chrono::steady_clock::now();
+    }
+
+    // adds a sample to a metric of the current frame or of the one framesAgo frames before it, ignored if that
+    // frame was a warmup frame
+    void record(const string& metric, double milliseconds, unsigned int framesAgo = 0) {
+        if (framesAgo > runFrame)
+            return;
+        // the scenarios run one after the other, each for its warmup and measured frames
+        unsigned int measured = runFrame - framesAgo;
+        unsigned int index = 0;
+        while (index < scenarios.size() && measured >= scenarios[index].warmupFrames + scenarios[index].frames) {
+            measured -= scenarios[index].warmupFrames + scenarios[index].frames;
+            index++;
+        }
+        if (index >= scenarios.size() || measured < scenarios[index].warmupFrames)
+            return;
+        Metric& samples = metricFor(index, metric);
+        samples.frames.push_back(measured - scenarios[index].warmupFrames);
+        samples.milliseconds.push_back(milliseconds);
+    }
+
+    // records the CPU time since beginFrame and the time since the previous frame ended, and moves on to the
+    // next frame. Called before the buffers are swapped.
+    void endFrame() {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        record("cpu", chrono::duration<double, milli>(now - frameStart).count());
+        if (frame > 0)
+            record("frame", chrono::duration<double, milli>(now - previousFrameEnd).count());
+        previousFrameEnd = now;
+        frame++;
+        runFrame++;
+        if (frame == scenario().warmupFrames + scenario().frames) {
+            current++;
+            frame = 0;
+        }
+    }
+
+    // writes <prefix>.csv with every sample and <prefix>.json with the summaries and prints the summaries
+    bool writeResults(const string& prefix) {
+        ofstream csv(prefix + ".csv");
+        ofstream json(prefix + ".json");
+        if (!csv || !json) {
+            cout << "ERROR::BENCHMARK:: failed to write the results to " << prefix << ".csv/.json" << endl;
+            return false;
+        }
+        writeCSV(csv);
+        writeJSON(json);
+        printSummary(cout);
+        return true;
+    }
+
+    void writeCSV(ostream& out) const {
+        out << "scenario,frame,metric,milliseconds" << endl;
+        for (unsigned int i = 0; i < results.size(); i++) {
+            for (unsigned int j = 0; j < results[i].metrics.size(); j++) {
+                const Metric& metric = results[i].metrics[j];
+                for (unsigned int k = 0; k < metric.milliseconds.size(); k++)
+                    out << scenarios[i].name << "," << metric.frames[k] << "," << metric.name << "," << metric.milliseconds[k] << endl;
+            }
+        }
+    }
+
+    void writeJSON(ostream& out) const {
+        out << "{" << endl << "  \"timeStep\": " << timeStep << "," << endl << "  \"scenarios\": [" << endl;
+        for (unsigned int i = 0; i < results.size(); i++) {
+            const BenchmarkScenario& scenario = scenarios[i];
+            out << "    {" << endl;
+            out << "      \"name\": \"" << scenario.name << "\"," << endl;
+            out << "      \"shadows\": " << boolalpha << scenario.shadows << ", \"parallax\": " << scenario.parallax
+                << ", \"bloom\": " << scenario.bloom << ", \"hdr\": " << scenario.hdr << noboolalpha << "," << endl;
+            out << "      \"warmupFrames\": " << scenario.warmupFrames << ", \"frames\": " << scenario.frames << "," << endl;
+            out << "      \"metrics\": {" << endl;
+            for (unsigned int j = 0; j < results[i].metrics.size(); j++) {
+                const Metric& metric = results[i].metrics[j];
+                Summary summary = summarize(metric.milliseconds);
+                out << "        \"" << metric.name << "\": { \"samples\": " << metric.milliseconds.size() << ", \"mean\": " << summary.mean
+                    << ", \"median\": " << summary.median << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99
+                    << ", \"min\": " << summary.min << ", \"max\": " << summary.max << ", \"stddev\": " << summary.stddev << " }"
+                    << (j + 1 < results[i].metrics.size() ? "," : "") << endl;
+            }
+            out << "      }" << endl << "    }" << (i + 1 < results.size() ? "," : "") << endl;
+        }
+        out << "  ]" << endl << "}" << endl;
+    }
+
+    void printSummary(ostream& out) const {
+        ios::fmtflags flags = out.flags();
+        streamsize precision = out.precision();
+        for (unsigned int i = 0; i < results.size(); i++) {
+            out << "BENCHMARK:: " << scenarios[i].name << endl;
+            for (unsigned int j = 0; j < results[i].metrics.size(); j++) {
+                const Metric& metric = results[i].metrics[j];
+                Summary summary = summarize(metric.milliseconds);
+                out << "    " << left << setw(20) << metric.name << right << fixed << setprecision(3)
+                    << " mean " << setw(8) << summary.mean << " median " << setw(8) << summary.median
+                    << " p95 " << setw(8) << summary.p95 << " stddev " << setw(8) << summary.stddev << " ms" << endl;
+            }
+        }
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+private:
+    struct Metric {
+        string name;
+        // frame of every sample, counted from the first measured frame
+        vector<unsigned int> frames;
+        vector<double> milliseconds;
+    };
+    struct ScenarioResult {
+        vector<Metric> metrics;
+    };
+    struct Summary {
+        double mean = 0.0, median = 0.0, p95 = 0.0, p99 = 0.0, min = 0.0, max = 0.0, stddev = 0.0;
+    };
+
+    // the results of the scenarios that started, in the order of scenarios
+    vector<ScenarioResult> results;
+    unsigned int current = 0;
+    // frame of the current scenario, warmup included
+    unsigned int frame = 0;
+    // frames of all scenarios so far
+    unsigned int runFrame = 0;
+    chrono::steady_clock::time_point frameStart, previousFrameEnd;
+
+    static CameraKey key(float time, glm::vec3 position, glm::vec3 target) {
+        CameraKey key;
+        key.time = time;
+        key.position = position;
+        key.target = target;
+        return key;
+    }
+
+    static BenchmarkScenario scenario(const string& name, const vector<CameraKey>& path) {
+        BenchmarkScenario scenario;
+        scenario.name = name;
+        scenario.path = path;
+        return scenario;
+    }
+
+    Metric& metricFor(unsigned int scenario, const string& name) {
+        if (results.size() <= scenario)
+            results.resize(scenario + 1);
+        vector<Metric>& metrics = results[scenario].metrics;
+        for (unsigned int i = 0; i < metrics.size(); i++) {
+            if (metrics[i].name == name)
+                return metrics[i];
+        }
+        Metric metric;
+        metric.name = name;
+        metrics.push_back(metric);
+        return metrics.back();
+    }
+
+    // nearest-rank percentile of sorted samples
+    static double percentile(const vector<double>& sorted, double fraction) {
+        size_t rank = (size_t)ceil(fraction * sorted.size());
+        return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+
+    static Summary summarize(vector<double> samples) {
+        Summary summary;
+        if (samples.empty())
+            return summary;
+        sort(samples.begin(), samples.end());
+        double sum = 0.0;
+        for (unsigned int i = 0; i < samples.size(); i++)
+            sum += samples[i];
+        summary.mean = sum / samples.size();
+        double squares = 0.0;
+        for (unsigned int i = 0; i < samples.size(); i++)
+            squares += (samples[i] - summary.mean) * (samples[i] - summary.mean);
+        summary.stddev = samples.size() > 1 ? sqrt(squares / (samples.size() - 1)) : 0.0;
+        summary.median = samples.size() % 2 == 1 ? samples[samples.size() / 2] : (samples[samples.size() / 2 - 1] + samples[samples.size() / 2]) / 2.0;
+        summary.p95 = percentile(samples, 0.95);
+        summary.p99 = percentile(samples, 0.99);
+        summary.min = samples.front();
+        summary.max = samples.back();
+        return summary;
+    }
+};
+#endif
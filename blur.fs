@@ -6,21 +6,26 @@ in vec2 TexCoords;
 uniform sampler2D image;
 
 uniform bool horizontal;
+// the scene covers only this part of the textures with dynamic resolution
+uniform vec2 renderScale = vec2(1.0);
 uniform float weight[5] = float[] (0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
 
 void main() {             
      vec2 tex_offset = 1.0 / textureSize(image, 0); // gets size of single texel
-     vec3 result = texture(image, TexCoords).rgb * weight[0];
+     vec2 uv = TexCoords * renderScale;
+     // don't sample the texels outside the rendered part
+     vec2 uvMax = renderScale - 0.5 * tex_offset;
+     vec3 result = texture(image, uv).rgb * weight[0];
      if(horizontal) {
          for(int i = 1; i < 5; ++i) {
-            result += texture(image, TexCoords + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-            result += texture(image, TexCoords - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
+            result += texture(image, min(uv + vec2(tex_offset.x * i, 0.0), uvMax)).rgb * weight[i];
+            result += texture(image, uv - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
          }
      }
      else {
          for(int i = 1; i < 5; ++i) {
-             result += texture(image, TexCoords + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-             result += texture(image, TexCoords - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
+             result += texture(image, min(uv + vec2(0.0, tex_offset.y * i), uvMax)).rgb * weight[i];
+             result += texture(image, uv - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
          }
      }
      FragColor = vec4(result, 1.0);
@@ -112,6 +112,16 @@ public:
             Zoom = 45.0f;
     }
 
+    // places the camera at position and turns it towards target
+    void LookAt(glm::vec3 position, glm::vec3 target)
+    {
+        Position = position;
+        glm::vec3 direction = glm::normalize(target - position);
+        Yaw = glm::degrees(atan2(direction.z, direction.x));
+        Pitch = glm::degrees(asin(direction.y));
+        updateCameraVectors();
+    }
+
 private:
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors()
@@ -0,0 +1,69 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// Picks the fraction of the output resolution the scene is rendered at, so the GPU time of a frame stays at a
+// target. The render targets keep their full size, only the viewport shrinks, so changing the scale costs
+// nothing. The GPU time arrives a few frames late (see GpuTimer), so after a change the controller waits for
+// measurements of the new scale before it changes again. Only new measurements may be fed, a repeated one would
+// weigh that frame more in the average and end the wait early.
+class DynamicResolution
+{
+public:
+    bool enabled = true;
+    // GPU time a frame may take, leaves some headroom below 60 Hz
+    float targetMilliseconds = 14.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    // measurements to skip after a change, at least the number of queries the GPU timer has in flight
+    unsigned int settleFrames = 6;
+
+    // the current scale of both axes
+    float scale = 1.0f;
+
+    // feeds a new GPU time of a frame, returns true if the scale changed
+    bool update(double gpuMilliseconds) {
+        float previous = scale;
+        if (!enabled) {
+            scale = maxScale;
+            return scale != previous;
+        }
+        if (gpuMilliseconds <= 0.0)
+            return false;
+        averageMilliseconds = averageMilliseconds <= 0.0f ? (float)gpuMilliseconds
+            : averageMilliseconds + ((float)gpuMilliseconds - averageMilliseconds) * 0.2f;
+        if (waitFrames > 0) {
+            waitFrames--;
+            return false;
+        }
+        // the GPU time grows roughly with the pixel count, the square of the scale. Going down has to be quick
+        // to hold the target, going up is slow and only with clear headroom, so the scale doesn't oscillate.
+        float desired = scale * std::sqrt(targetMilliseconds / averageMilliseconds);
+        if (averageMilliseconds > targetMilliseconds)
+            desired = std::max(desired, scale * 0.85f);
+        else if (averageMilliseconds < targetMilliseconds * 0.85f)
+            desired = std::min(desired, scale * 1.05f);
+        else
+            desired = scale;
+        // steps of 1/32, small changes aren't worth a different resolution
+        desired = std::floor(desired * 32.0f + 0.5f) / 32.0f;
+        scale = std::min(maxScale, std::max(minScale, desired));
+        if (scale == previous)
+            return false;
+        waitFrames = settleFrames;
+        return true;
+    }
+
+    // size of the rendered part of a target of the given size
+    unsigned int scaled(unsigned int size) const {
+        return std::max(1u, (unsigned int)(size * scale + 0.5f));
+    }
+
+private:
+    float averageMilliseconds = 0.0f;
+    unsigned int waitFrames = 0;
+};
+#endif
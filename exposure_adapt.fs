@@ -0,0 +1,22 @@
+#version 330 core
+out float AdaptedLuminance;
+
+// log2 luminance of the scene, its last level is the mean
+uniform sampler2D logLuminance;
+uniform int luminanceLevel;
+// adapted luminance of the previous frame, 0 before the first frame
+uniform sampler2D previousLuminance;
+// fraction of the way to the measured luminance covered this frame
+uniform float adaptation;
+uniform float minLuminance;
+uniform float maxLuminance;
+
+void main()
+{
+    float measured = clamp(exp2(texelFetch(logLuminance, ivec2(0), luminanceLevel).r), minLuminance, maxLuminance);
+    float previous = texelFetch(previousLuminance, ivec2(0), 0).r;
+    if (previous <= 0.0)
+        previous = measured;
+    // adapt in log space, so going darker and going brighter by the same factor take equally long
+    AdaptedLuminance = exp2(mix(log2(previous), log2(measured), adaptation));
+}
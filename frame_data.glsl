@@ -0,0 +1,19 @@
+// The uniform blocks of the frame and of a draw call, bound to FRAME_UNIFORM_BINDING and OBJECT_UNIFORM_BINDING.
+// Their std140 layout has to match FrameUniforms and ObjectUniforms in upload_ring.h.
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 shadowMatrices[6];
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 params; // x: far plane of the shadow cubemap, y: parallax height scale
+    ivec4 toggles; // x: shadows, y: parallax (the pbs shaders compile them in as HAS_SHADOWS and HAS_PARALLAX)
+    mat4 previousViewProjection; // unjittered, for the motion vectors
+    vec4 jitter; // xy: sub-pixel offset of the projection in ndc
+};
+layout (std140) uniform ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    ivec4 flags; // x: bit mask of the shadow cubemap faces the object touches
+};
@@ -0,0 +1,118 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// world space axis aligned bounding box, stored as center and half extents
+struct BoundingBox {
+    glm::vec3 center;
+    glm::vec3 extents;
+};
+
+// transforms a local bounding box and returns the bounding box of the result (Arvo's method)
+inline BoundingBox transformBoundingBox(const glm::mat4& model, const glm::vec3& center, const glm::vec3& extents)
+{
+    BoundingBox box;
+    box.center = glm::vec3(model * glm::vec4(center, 1.0f));
+    for (int row = 0; row < 3; row++) {
+        box.extents[row] = std::fabs(model[0][row]) * extents.x + std::fabs(model[1][row]) * extents.y + std::fabs(model[2][row]) * extents.z;
+    }
+    return box;
+}
+
+// The six planes of a view frustum, extracted from a projection * view matrix (Gribb/Hartmann).
+// The planes point inwards, a point p is inside if dot(plane.xyz, p) + plane.w >= 0 for all of them.
+// The tests check four planes at once with SSE, the planes are kept in SoA form for that.
+class Frustum
+{
+public:
+    glm::vec4 planes[6];
+
+    Frustum() {}
+
+    explicit Frustum(const glm::mat4& viewProjection) {
+        setMatrix(viewProjection);
+    }
+
+    void setMatrix(const glm::mat4& m) {
+        for (int i = 0; i < 3; i++) {
+            glm::vec4 row = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+            glm::vec4 last = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+            planes[i * 2] = last + row;      // left, bottom, near
+            planes[i * 2 + 1] = last - row;  // right, top, far
+        }
+        for (int i = 0; i < 6; i++) {
+            float length = glm::length(glm::vec3(planes[i]));
+            planes[i] = planes[i] / length;
+        }
+        // SoA copy, the last two lanes of the second group repeat the far plane
+        for (int i = 0; i < 8; i++) {
+            const glm::vec4& plane = planes[i < 6 ? i : 5];
+            planeX[i] = plane.x;
+            planeY[i] = plane.y;
+            planeZ[i] = plane.z;
+            planeW[i] = plane.w;
+        }
+    }
+
+    // true if the box is at least partially inside the frustum
+    bool intersects(const BoundingBox& box) const {
+#ifdef FRUSTUM_SSE
+        __m128 cx = _mm_set1_ps(box.center.x), cy = _mm_set1_ps(box.center.y), cz = _mm_set1_ps(box.center.z);
+        __m128 ex = _mm_set1_ps(box.extents.x), ey = _mm_set1_ps(box.extents.y), ez = _mm_set1_ps(box.extents.z);
+        __m128 signMask = _mm_set1_ps(-0.0f);
+        for (int group = 0; group < 8; group += 4) {
+            __m128 px = _mm_loadu_ps(planeX + group), py = _mm_loadu_ps(planeY + group), pz = _mm_loadu_ps(planeZ + group);
+            // distance of the center and projected radius of the box on the plane normals
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)), _mm_add_ps(_mm_mul_ps(pz, cz), _mm_loadu_ps(planeW + group)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, px), ex), _mm_mul_ps(_mm_andnot_ps(signMask, py), ey)), _mm_mul_ps(_mm_andnot_ps(signMask, pz), ez));
+            if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps())) != 0)
+                return false;
+        }
+        return true;
+#else
+        for (int i = 0; i < 6; i++) {
+            float distance = planeX[i] * box.center.x + planeY[i] * box.center.y + planeZ[i] * box.center.z + planeW[i];
+            float radius = std::fabs(planeX[i]) * box.extents.x + std::fabs(planeY[i]) * box.extents.y + std::fabs(planeZ[i]) * box.extents.z;
+            if (distance + radius < 0.0f)
+                return false;
+        }
+        return true;
+#endif
+    }
+
+    // true if the sphere is at least partially inside the frustum
+    bool intersects(const glm::vec3& center, float sphereRadius) const {
+#ifdef FRUSTUM_SSE
+        __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+        __m128 negativeRadius = _mm_set1_ps(-sphereRadius);
+        for (int group = 0; group < 8; group += 4) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(planeX + group), cx), _mm_mul_ps(_mm_loadu_ps(planeY + group), cy)),
+                _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(planeZ + group), cz), _mm_loadu_ps(planeW + group)));
+            if (_mm_movemask_ps(_mm_cmplt_ps(distance, negativeRadius)) != 0)
+                return false;
+        }
+        return true;
+#else
+        for (int i = 0; i < 6; i++) {
+            if (planeX[i] * center.x + planeY[i] * center.y + planeZ[i] * center.z + planeW[i] < -sphereRadius)
+                return false;
+        }
+        return true;
+#endif
+    }
+
+private:
+    float planeX[8];
+    float planeY[8];
+    float planeZ[8];
+    float planeW[8];
+};
+#endif
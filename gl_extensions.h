@@ -0,0 +1,95 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// glad is generated for plain GL 3.3 core, so the few newer entry points we can take advantage of
+// are loaded here by hand and only used if the driver reports them.
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP PFN_GL_BUFFER_STORAGE)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void (APIENTRYP PFN_GL_MAX_SHADER_COMPILER_THREADS)(GLuint count);
+
+class GLExtensions
+{
+public:
+    // GL_ARB_buffer_storage (core in 4.4): immutable buffers that can stay mapped while the GPU reads them
+    bool bufferStorage = false;
+    PFN_GL_BUFFER_STORAGE glBufferStorage = nullptr;
+    // GL_EXT_texture_compression_s3tc: BC1/BC3 textures (BC4/BC5 are core as RGTC)
+    bool textureCompressionS3TC = false;
+    // GL_EXT_texture_sRGB: the sRGB variants of the S3TC formats
+    bool textureSRGB = false;
+    // GL_KHR_parallel_shader_compile (or the ARB version): programs compile on driver threads and can be asked
+    // whether they are done with GL_COMPLETION_STATUS_KHR
+    bool parallelShaderCompile = false;
+    PFN_GL_MAX_SHADER_COMPILER_THREADS glMaxShaderCompilerThreads = nullptr;
+
+    // queries the extensions of the current context, call once after gladLoadGLLoader
+    void load(GLADloadproc loader) {
+        if (has("GL_ARB_buffer_storage") || versionAtLeast(4, 4)) {
+            glBufferStorage = (PFN_GL_BUFFER_STORAGE)loader("glBufferStorage");
+            bufferStorage = glBufferStorage != nullptr;
+        }
+        textureCompressionS3TC = has("GL_EXT_texture_compression_s3tc");
+        textureSRGB = has("GL_EXT_texture_sRGB");
+        if (has("GL_KHR_parallel_shader_compile"))
+            glMaxShaderCompilerThreads = (PFN_GL_MAX_SHADER_COMPILER_THREADS)loader("glMaxShaderCompilerThreadsKHR");
+        else if (has("GL_ARB_parallel_shader_compile"))
+            glMaxShaderCompilerThreads = (PFN_GL_MAX_SHADER_COMPILER_THREADS)loader("glMaxShaderCompilerThreadsARB");
+        parallelShaderCompile = glMaxShaderCompilerThreads != nullptr;
+        // let the driver pick the number of compiler threads
+        if (parallelShaderCompile)
+            glMaxShaderCompilerThreads(0xFFFFFFFF);
+    }
+
+    static bool has(const char* name) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (extension && std::strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    static bool versionAtLeast(int major, int minor) {
+        GLint contextMajor = 0, contextMinor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+        glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+        return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+    }
+};
+
+// the extensions of the (single) GL context
+inline GLExtensions& glExtensions()
+{
+    static GLExtensions extensions;
+    return extensions;
+}
+#endif
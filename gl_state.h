@@ -0,0 +1,234 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// Thin layer that remembers the GL state set through it and filters calls that wouldn't change anything.
+// All binds of the program, framebuffer, VAO, buffers, textures, depth func, sRGB and viewport have to go
+// through glState(), and so do the deletes of framebuffers and textures, otherwise the cache gets out of sync with
+// the context (call invalidate() if that is unavoidable).
+class GLState
+{
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+
+    // number of calls forwarded to GL and filtered out, for the current and the last finished frame
+    unsigned int issuedCalls = 0;
+    unsigned int redundantCalls = 0;
+    unsigned int lastFrameIssuedCalls = 0;
+    unsigned int lastFrameRedundantCalls = 0;
+
+    GLState() {
+        invalidate();
+    }
+
+    // forgets everything, so the next call of every kind is forwarded
+    void invalidate() {
+        program = INVALID;
+        framebuffer = INVALID;
+        readFramebuffer = INVALID;
+        vertexArray = INVALID;
+        arrayBuffer = INVALID;
+        uniformBuffer = INVALID;
+        activeUnit = INVALID;
+        for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+            texture2D[i] = INVALID;
+            textureCube[i] = INVALID;
+        }
+        depthFunction = INVALID;
+        framebufferSRGB = -1;
+        blend = -1;
+        depthMask = -1;
+        viewportX = viewportY = viewportWidth = viewportHeight = -1;
+    }
+
+    // closes the counters of the current frame
+    void newFrame() {
+        lastFrameIssuedCalls = issuedCalls;
+        lastFrameRedundantCalls = redundantCalls;
+        issuedCalls = 0;
+        redundantCalls = 0;
+    }
+
+    void useProgram(GLuint id) {
+        if (changed(program, id))
+            glUseProgram(id);
+    }
+
+    // binds the framebuffer for both reading and drawing
+    void bindFramebuffer(GLuint id) {
+        if (framebuffer == id && readFramebuffer == id) {
+            redundantCalls++;
+            return;
+        }
+        framebuffer = id;
+        readFramebuffer = id;
+        glBindFramebuffer(GL_FRAMEBUFFER, id);
+        issuedCalls++;
+    }
+
+    // binds a different framebuffer to read from (e.g. the source of a blit), the next bindFramebuffer binds both
+    void bindReadFramebuffer(GLuint id) {
+        if (changed(readFramebuffer, id))
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, id);
+    }
+
+    // GL unbinds deleted objects itself and may hand out their names again, so the cache has to forget them too,
+    // otherwise the bind of a new object with a reused name would be filtered out
+    void deleteFramebuffer(GLuint id) {
+        if (framebuffer == id)
+            framebuffer = 0;
+        if (readFramebuffer == id)
+            readFramebuffer = 0;
+        glDeleteFramebuffers(1, &id);
+    }
+
+    void deleteTexture(GLuint id) {
+        for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+            if (texture2D[i] == id)
+                texture2D[i] = 0;
+            if (textureCube[i] == id)
+                textureCube[i] = 0;
+        }
+        glDeleteTextures(1, &id);
+    }
+
+    void bindVertexArray(GLuint id) {
+        if (changed(vertexArray, id))
+            glBindVertexArray(id);
+    }
+
+    // only the array and uniform buffer bindings are cached, the element array buffer belongs to the VAO
+    void bindBuffer(GLenum target, GLuint id) {
+        if (target == GL_ARRAY_BUFFER) {
+            if (changed(arrayBuffer, id))
+                glBindBuffer(target, id);
+        }
+        else if (target == GL_UNIFORM_BUFFER) {
+            if (changed(uniformBuffer, id))
+                glBindBuffer(target, id);
+        }
+        else {
+            glBindBuffer(target, id);
+            issuedCalls++;
+        }
+    }
+
+    void activeTexture(GLenum unit) {
+        if (changed(activeUnit, unit))
+            glActiveTexture(unit);
+    }
+
+    // binds the texture to the currently active unit
+    void bindTexture(GLenum target, GLuint id) {
+        unsigned int unit = activeUnit == INVALID ? 0 : activeUnit - GL_TEXTURE0;
+        GLuint* slot = textureSlot(target, unit);
+        if (slot == nullptr) {
+            glBindTexture(target, id);
+            issuedCalls++;
+        }
+        else if (changed(*slot, id))
+            glBindTexture(target, id);
+    }
+
+    // activates the unit only if the texture bound to it actually has to change
+    void bindTexture(unsigned int unit, GLenum target, GLuint id) {
+        GLuint* slot = textureSlot(target, unit);
+        if (slot != nullptr && *slot == id) {
+            redundantCalls++;
+            return;
+        }
+        activeTexture(GL_TEXTURE0 + unit);
+        bindTexture(target, id);
+    }
+
+    void depthFunc(GLenum func) {
+        if (changed(depthFunction, func))
+            glDepthFunc(func);
+    }
+
+    void setDepthMask(bool enabled) {
+        if (changed(depthMask, enabled ? 1 : 0))
+            glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    }
+
+    void setFramebufferSRGB(bool enabled) {
+        if (changed(framebufferSRGB, enabled ? 1 : 0)) {
+            if (enabled)
+                glEnable(GL_FRAMEBUFFER_SRGB);
+            else
+                glDisable(GL_FRAMEBUFFER_SRGB);
+        }
+    }
+
+    void setBlend(bool enabled) {
+        if (changed(blend, enabled ? 1 : 0)) {
+            if (enabled)
+                glEnable(GL_BLEND);
+            else
+                glDisable(GL_BLEND);
+        }
+    }
+
+    void viewport(int x, int y, int width, int height) {
+        if (x == viewportX && y == viewportY && width == viewportWidth && height == viewportHeight) {
+            redundantCalls++;
+            return;
+        }
+        viewportX = x;
+        viewportY = y;
+        viewportWidth = width;
+        viewportHeight = height;
+        glViewport(x, y, width, height);
+        issuedCalls++;
+    }
+
+private:
+    static const GLuint INVALID = 0xFFFFFFFFu;
+
+    GLuint program;
+    // the draw framebuffer, and the read framebuffer that differs from it only after bindReadFramebuffer
+    GLuint framebuffer;
+    GLuint readFramebuffer;
+    GLuint vertexArray;
+    GLuint arrayBuffer;
+    GLuint uniformBuffer;
+    GLuint activeUnit;
+    GLuint texture2D[MAX_TEXTURE_UNITS];
+    GLuint textureCube[MAX_TEXTURE_UNITS];
+    GLuint depthFunction;
+    int framebufferSRGB;
+    int blend;
+    int depthMask;
+    int viewportX, viewportY, viewportWidth, viewportHeight;
+
+    // stores the new value and returns true if it differs from the cached one
+    template <typename T>
+    bool changed(T& cached, T value) {
+        if (cached == value) {
+            redundantCalls++;
+            return false;
+        }
+        cached = value;
+        issuedCalls++;
+        return true;
+    }
+
+    GLuint* textureSlot(GLenum target, unsigned int unit) {
+        if (unit >= MAX_TEXTURE_UNITS)
+            return nullptr;
+        if (target == GL_TEXTURE_2D)
+            return &texture2D[unit];
+        if (target == GL_TEXTURE_CUBE_MAP)
+            return &textureCube[unit];
+        return nullptr;
+    }
+};
+
+// the state cache of the (single) GL context
+inline GLState& glState()
+{
+    static GLState state;
+    return state;
+}
+#endif
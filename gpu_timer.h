@@ -0,0 +1,64 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// GPU time of the commands between begin() and end(), measured with GL_TIME_ELAPSED queries. A result is only
+// read once the query reports it available, usually a few frames later, so measuring never waits for the GPU.
+// Only one timer can run at a time (GL allows a single active GL_TIME_ELAPSED query).
+class GpuTimer
+{
+public:
+    static const unsigned int QUERY_COUNT = 4;
+
+    // the latest measured time, 0 until the first result arrived
+    double milliseconds = 0.0;
+    // whether the last begin() collected a new result, milliseconds is otherwise the one of an earlier frame
+    bool fresh = false;
+    // number of spans that weren't measured because all queries were still in flight
+    unsigned int skipped = 0;
+
+    void init() {
+        glGenQueries(QUERY_COUNT, queries);
+    }
+
+    // collects the results that arrived and starts measuring
+    void begin() {
+        fresh = false;
+        while (pending > 0) {
+            GLuint query = queries[oldest];
+            GLint available = 0;
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+            milliseconds = nanoseconds / 1000000.0;
+            fresh = true;
+            oldest = (oldest + 1) % QUERY_COUNT;
+            pending--;
+        }
+        if (pending == QUERY_COUNT) {
+            skipped++;
+            return;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, queries[(oldest + pending) % QUERY_COUNT]);
+        running = true;
+    }
+
+    void end() {
+        if (!running)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        running = false;
+        pending++;
+    }
+
+private:
+    GLuint queries[QUERY_COUNT] = {};
+    // queries in flight are oldest, oldest + 1, ... (mod QUERY_COUNT)
+    unsigned int oldest = 0;
+    unsigned int pending = 0;
+    bool running = false;
+};
+#endif
@@ -0,0 +1,24 @@
+#version 330 core
+out float MaxDepth;
+
+// the previous level of the pyramid (or the depth buffer for the first level), restricted to that level
+// with GL_TEXTURE_BASE_LEVEL, so lod 0 is the source level
+uniform sampler2D sourceDepth;
+
+void main()
+{
+    ivec2 sourceSize = textureSize(sourceDepth, 0);
+    ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+    // with an odd source size the last texel of a row/column also covers the leftover source texel
+    ivec2 extent = ivec2(1);
+    if (base.x + 3 == sourceSize.x)
+        extent.x = 2;
+    if (base.y + 3 == sourceSize.y)
+        extent.y = 2;
+    // keep the farthest depth, so an object behind a texel is behind everything it covers
+    float depth = 0.0;
+    for (int y = 0; y <= extent.y; ++y)
+        for (int x = 0; x <= extent.x; ++x)
+            depth = max(depth, texelFetch(sourceDepth, min(base + ivec2(x, y), sourceSize - 1), 0).r);
+    MaxDepth = depth;
+}
@@ -0,0 +1,194 @@
+#ifndef IMAGE_COMPARE_H
+#define IMAGE_COMPARE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Comparison of rendered frames with golden images, to see whether a change of the renderer changed its output.
+// The difference is perceptual in the spirit of FLIP, so dithering and sub-pixel differences of the
+// anti-aliasing pass while visible changes don't:
+// - both images are converted to CIELAB and blurred by a small Gaussian, a stand-in for the contrast
+//   sensitivity of the eye, which doesn't see single pixel noise at a normal viewing distance
+// - the color error of a pixel is the HyAB distance of the blurred colors
+// - edges that moved, appeared or vanished (the gradients of the lightness differ) amplify the color error
+// Errors are in [0, 1]. The images are 8 bit sRGB, stored as binary PPM files.
+
+// an 8 bit rgb image, the first row is the top one
+struct RGBImage {
+    unsigned int width = 0, height = 0;
+    vector<unsigned char> pixels;
+};
+
+// how much two images may differ
+struct ImageTolerance {
+    // the mean error of all pixels
+    double meanError = 0.01;
+    // pixels with a larger error fail...
+    double pixelError = 0.2;
+    // ... and only this share of the pixels may fail
+    double failingShare = 0.001;
+};
+
+struct ImageDifference {
+    double meanError = 0.0;
+    double maxError = 0.0;
+    // share of the pixels over ImageTolerance::pixelError
+    double failingShare = 0.0;
+    // the error of every pixel as grey level
+    RGBImage errorMap;
+
+    bool passes(const ImageTolerance& tolerance) const {
+        return meanError <= tolerance.meanError && failingShare <= tolerance.failingShare;
+    }
+};
+
+// reads the color of the bound read framebuffer, needs the GL context
+inline RGBImage readFramebuffer(unsigned int width, unsigned int height)
+{
+    RGBImage image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize((size_t)width * height * 3);
+    vector<unsigned char> rows(image.pixels.size());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rows.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // GL returns the bottom row first
+    size_t rowSize = (size_t)width * 3;
+    for (unsigned int y = 0; y < height; y++)
+        copy(rows.begin() + (height - 1 - y) * rowSize, rows.begin() + (height - y) * rowSize, image.pixels.begin() + y * rowSize);
+    return image;
+}
+
+inline bool writePPM(const string& path, const RGBImage& image)
+{
+    ofstream file(path.c_str(), ios::binary);
+    if (!file)
+        return false;
+    file << "P6\n" << image.width << " " << image.height << "\n255\n";
+    file.write((const char*)image.pixels.data(), image.pixels.size());
+    return (bool)file;
+}
+
+// reads a binary PPM with 8 bit channels, as written by writePPM
+inline bool readPPM(const string& path, RGBImage& image)
+{
+    ifstream file(path.c_str(), ios::binary);
+    string magic;
+    unsigned int maxValue = 0;
+    file >> magic >> image.width >> image.height >> maxValue;
+    if (!file || magic != "P6" || maxValue != 255)
+        return false;
+    file.get();
+    image.pixels.resize((size_t)image.width * image.height * 3);
+    file.read((char*)image.pixels.data(), image.pixels.size());
+    return (bool)file;
+}
+
+// the pixels of an image in CIELAB (D65 white), blurred with a 3 x 3 binomial filter
+inline vector<float> perceptualImage(const RGBImage& image)
+{
+    size_t pixelCount = (size_t)image.width * image.height;
+    vector<float> lab(pixelCount * 3);
+    for (size_t i = 0; i < pixelCount; i++) {
+        float linear[3];
+        for (unsigned int c = 0; c < 3; c++) {
+            float value = image.pixels[i * 3 + c] / 255.0f;
+            linear[c] = value <= 0.04045f ? value / 12.92f : pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+        // relative to the white point
+        float x = (0.4124f * linear[0] + 0.3576f * linear[1] + 0.1805f * linear[2]) / 0.9505f;
+        float y = 0.2126f * linear[0] + 0.7152f * linear[1] + 0.0722f * linear[2];
+        float z = (0.0193f * linear[0] + 0.1192f * linear[1] + 0.9505f * linear[2]) / 1.089f;
+        float f[3] = { x, y, z };
+        for (unsigned int c = 0; c < 3; c++)
+            f[c] = f[c] > 0.008856f ? pow(f[c], 1.0f / 3.0f) : 7.787f * f[c] + 16.0f / 116.0f;
+        lab[i * 3] = 116.0f * f[1] - 16.0f;
+        lab[i * 3 + 1] = 500.0f * (f[0] - f[1]);
+        lab[i * 3 + 2] = 200.0f * (f[1] - f[2]);
+    }
+    vector<float> blurred(lab.size());
+    const float weights[3] = { 0.25f, 0.5f, 0.25f };
+    for (unsigned int y = 0; y < image.height; y++) {
+        for (unsigned int x = 0; x < image.width; x++) {
+            for (unsigned int c = 0; c < 3; c++) {
+                float sum = 0.0f;
+                for (int dy = -1; dy <= 1; dy++) {
+                    unsigned int sy = (unsigned int)std::min(std::max((int)y + dy, 0), (int)image.height - 1);
+                    for (int dx = -1; dx <= 1; dx++) {
+                        unsigned int sx = (unsigned int)std::min(std::max((int)x + dx, 0), (int)image.width - 1);
+                        sum += weights[dy + 1] * weights[dx + 1] * lab[((size_t)sy * image.width + sx) * 3 + c];
+                    }
+                }
+                blurred[((size_t)y * image.width + x) * 3 + c] = sum;
+            }
+        }
+    }
+    return blurred;
+}
+
+// the magnitude of the Sobel gradient of the lightness (L / 100) of a perceptual image at a pixel
+inline float lightnessGradient(const vector<float>& lab, unsigned int width, unsigned int height, unsigned int x, unsigned int y)
+{
+    float samples[3][3];
+    for (int dy = -1; dy <= 1; dy++) {
+        unsigned int sy = (unsigned int)std::min(std::max((int)y + dy, 0), (int)height - 1);
+        for (int dx = -1; dx <= 1; dx++) {
+            unsigned int sx = (unsigned int)std::min(std::max((int)x + dx, 0), (int)width - 1);
+            samples[dy + 1][dx + 1] = lab[((size_t)sy * width + sx) * 3] / 100.0f;
+        }
+    }
+    float gx = (samples[0][2] + 2.0f * samples[1][2] + samples[2][2] - samples[0][0] - 2.0f * samples[1][0] - samples[2][0]) / 4.0f;
+    float gy = (samples[2][0] + 2.0f * samples[2][1] + samples[2][2] - samples[0][0] - 2.0f * samples[0][1] - samples[0][2]) / 4.0f;
+    return sqrt(gx * gx + gy * gy);
+}
+
+// the perceptual difference of an image to its reference, both of the same size
+inline ImageDifference compareImages(const RGBImage& reference, const RGBImage& test, const ImageTolerance& tolerance)
+{
+    ImageDifference difference;
+    if (reference.width != test.width || reference.height != test.height) {
+        difference.meanError = difference.maxError = difference.failingShare = 1.0;
+        return difference;
+    }
+    // HyAB distance of pure green and pure blue, the largest that occurs in practice
+    const float COLOR_ERROR_RANGE = 200.0f;
+    vector<float> referenceLab = perceptualImage(reference);
+    vector<float> testLab = perceptualImage(test);
+    unsigned int width = reference.width, height = reference.height;
+    difference.errorMap.width = width;
+    difference.errorMap.height = height;
+    difference.errorMap.pixels.resize(reference.pixels.size());
+    double sum = 0.0;
+    size_t failing = 0;
+    for (unsigned int y = 0; y < height; y++) {
+        for (unsigned int x = 0; x < width; x++) {
+            size_t i = ((size_t)y * width + x) * 3;
+            float dL = referenceLab[i] - testLab[i];
+            float da = referenceLab[i + 1] - testLab[i + 1];
+            float db = referenceLab[i + 2] - testLab[i + 2];
+            float hyab = fabs(dL) + sqrt(da * da + db * db);
+            float colorError = pow(std::min(1.0f, hyab / COLOR_ERROR_RANGE), 0.7f);
+            float featureError = sqrt(std::min(1.0f, fabs(lightnessGradient(referenceLab, width, height, x, y) - lightnessGradient(testLab, width, height, x, y)) / sqrt(2.0f)));
+            // an error of 0 stays 0, with a changed edge small color errors count nearly fully
+            float error = colorError > 0.0f ? pow(colorError, 1.0f - featureError) : 0.0f;
+            sum += error;
+            difference.maxError = std::max(difference.maxError, (double)error);
+            if (error > tolerance.pixelError)
+                failing++;
+            unsigned char grey = (unsigned char)std::min(255.0f, error * 255.0f + 0.5f);
+            difference.errorMap.pixels[i] = difference.errorMap.pixels[i + 1] = difference.errorMap.pixels[i + 2] = grey;
+        }
+    }
+    size_t pixelCount = (size_t)width * height;
+    difference.meanError = pixelCount > 0 ? sum / pixelCount : 0.0;
+    difference.failingShare = pixelCount > 0 ? (double)failing / pixelCount : 0.0;
+    return difference;
+}
+#endif
@@ -0,0 +1,265 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Work-stealing scheduler for the CPU work of the application: importing models, decoding images and generating
+// their mip chains, decoding the environment map and traversing the scene every frame. Every worker has its own
+// queue; it runs its newest job first (what it just submitted is likely still in its cache) and, when the
+// queue is empty, steals the oldest job of another queue. Jobs start once the jobs they depend on are done.
+// A thread that waits for a job runs queued jobs meanwhile instead of blocking. Jobs must not touch GL, their
+// results are consumed by the GL thread once they are done.
+class JobSystem
+{
+public:
+    class Job;
+    // a submitted job, to wait for it or to start other jobs after it
+    typedef shared_ptr<Job> JobHandle;
+
+    class Job
+    {
+    private:
+        friend class JobSystem;
+        function<void()> work;
+        // dependencies that didn't finish yet, plus one while the job is being submitted
+        atomic<unsigned int> blockingJobs;
+        mutex finishMutex;
+        bool finished = false;
+        // jobs that wait for this one
+        vector<JobHandle> continuations;
+
+    public:
+        explicit Job(function<void()> work) : work(work), blockingJobs(1) {}
+
+        bool done() {
+            lock_guard<mutex> lock(finishMutex);
+            return finished;
+        }
+    };
+
+    // what a thread did since the last takeStats
+    struct WorkerStats {
+        unsigned int jobs = 0;
+        // jobs taken from the queue of another thread
+        unsigned int steals = 0;
+        double busyMilliseconds = 0.0;
+    };
+
+    JobSystem() : queues(workerCount() + 1) {}
+
+    ~JobSystem() {
+        {
+            lock_guard<mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+        for (unsigned int i = 0; i < threads.size(); i++)
+            threads[i].join();
+    }
+
+    // number of threads that run jobs, one core stays with the GL thread
+    unsigned int workerCount() const {
+        return std::max(2u, thread::hardware_concurrency()) - 1;
+    }
+
+    // queues a job that runs once all dependencies are done
+    JobHandle submit(function<void()> work, const vector<JobHandle>& dependencies = vector<JobHandle>()) {
+        // the threads are started with the first job
+        call_once(threadsStarted, [this]() {
+            for (unsigned int i = 0; i < workerCount(); i++)
+                threads.push_back(thread([this, i]() { run(i); }));
+        });
+        JobHandle job = make_shared<Job>(work);
+        pending++;
+        for (unsigned int i = 0; i < dependencies.size(); i++) {
+            Job& dependency = *dependencies[i];
+            lock_guard<mutex> lock(dependency.finishMutex);
+            if (!dependency.finished) {
+                job->blockingJobs++;
+                dependency.continuations.push_back(job);
+            }
+        }
+        if (--job->blockingJobs == 0)
+            schedule(job);
+        return job;
+    }
+
+    // blocks until the job has finished, running other jobs meanwhile
+    void wait(const JobHandle& job) {
+        waitUntil([&job]() { return job->done(); });
+    }
+
+    // blocks until all submitted jobs have finished
+    void wait() {
+        waitUntil([this]() { return pending == 0; });
+    }
+
+    // calls job(0) ... job(count - 1) on the workers and the calling thread and returns when all calls are done.
+    // Only waits for its own calls, not for other jobs that were submitted.
+    void parallelFor(unsigned int count, const function<void(unsigned int)>& job) {
+        vector<JobHandle> handles;
+        for (unsigned int i = 1; i < count; i++)
+            handles.push_back(submit([&job, i]() { job(i); }));
+        if (count > 0)
+            job(0);
+        for (unsigned int i = 0; i < handles.size(); i++)
+            wait(handles[i]);
+    }
+
+    // the counters of thread i (workerCount() is the GL thread, while it helps waiting) since the last call
+    WorkerStats takeStats(unsigned int index) {
+        WorkerQueue& queue = queues[index];
+        WorkerStats stats;
+        stats.jobs = queue.jobs.exchange(0);
+        stats.steals = queue.steals.exchange(0);
+        stats.busyMilliseconds = queue.busyMicroseconds.exchange(0) / 1000.0;
+        return stats;
+    }
+
+private:
+    struct WorkerQueue {
+        mutex queueMutex;
+        deque<JobHandle> queued;
+        // counters of the thread that owns the queue
+        atomic<unsigned int> jobs;
+        atomic<unsigned int> steals;
+        atomic<uint64_t> busyMicroseconds;
+
+        WorkerQueue() : jobs(0), steals(0), busyMicroseconds(0) {}
+    };
+
+    // one queue per worker, the last one takes the jobs submitted by other threads
+    vector<WorkerQueue> queues;
+    vector<thread> threads;
+    once_flag threadsStarted;
+    // jobs submitted and not finished yet, and jobs waiting in a queue
+    atomic<unsigned int> pending{ 0 };
+    atomic<unsigned int> queuedJobs{ 0 };
+    bool stopping = false;
+    // guards sleeping: workers wait for queued jobs, waiting threads for finished ones
+    mutex sleepMutex;
+    condition_variable jobAvailable, jobFinished;
+
+    // the queue of the calling thread
+    unsigned int ownQueue() const {
+        return workerIndex() < queues.size() ? workerIndex() : (unsigned int)queues.size() - 1;
+    }
+
+    static unsigned int& workerIndex() {
+        static thread_local unsigned int index = ~0u;
+        return index;
+    }
+
+    void schedule(const JobHandle& job) {
+        WorkerQueue& queue = queues[ownQueue()];
+        {
+            lock_guard<mutex> lock(queue.queueMutex);
+            queue.queued.push_back(job);
+        }
+        {
+            lock_guard<mutex> lock(sleepMutex);
+            queuedJobs++;
+        }
+        jobAvailable.notify_one();
+        // a thread waiting for a job can help with this one
+        jobFinished.notify_all();
+    }
+
+    // the newest job of the own queue, or else the oldest one of another queue
+    JobHandle take(unsigned int own) {
+        {
+            WorkerQueue& queue = queues[own];
+            lock_guard<mutex> lock(queue.queueMutex);
+            if (!queue.queued.empty()) {
+                JobHandle job = queue.queued.back();
+                queue.queued.pop_back();
+                queuedJobs--;
+                return job;
+            }
+        }
+        for (unsigned int i = 1; i < queues.size(); i++) {
+            WorkerQueue& queue = queues[(own + i) % queues.size()];
+            lock_guard<mutex> lock(queue.queueMutex);
+            if (!queue.queued.empty()) {
+                JobHandle job = queue.queued.front();
+                queue.queued.pop_front();
+                queuedJobs--;
+                queues[own].steals++;
+                return job;
+            }
+        }
+        return JobHandle();
+    }
+
+    void execute(Job& job, unsigned int own) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        job.work();
+        job.work = nullptr;
+        WorkerQueue& queue = queues[own];
+        queue.jobs++;
+        queue.busyMicroseconds += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+
+        vector<JobHandle> continuations;
+        {
+            lock_guard<mutex> lock(job.finishMutex);
+            job.finished = true;
+            continuations.swap(job.continuations);
+        }
+        for (unsigned int i = 0; i < continuations.size(); i++) {
+            if (--continuations[i]->blockingJobs == 0)
+                schedule(continuations[i]);
+        }
+        {
+            lock_guard<mutex> lock(sleepMutex);
+            pending--;
+        }
+        jobFinished.notify_all();
+    }
+
+    void run(unsigned int index) {
+        workerIndex() = index;
+        while (true) {
+            JobHandle job = take(index);
+            if (job) {
+                execute(*job, index);
+                continue;
+            }
+            unique_lock<mutex> lock(sleepMutex);
+            jobAvailable.wait(lock, [this]() { return stopping || queuedJobs > 0; });
+            if (stopping && queuedJobs == 0)
+                return;
+        }
+    }
+
+    void waitUntil(const function<bool()>& condition) {
+        unsigned int own = ownQueue();
+        while (!condition()) {
+            JobHandle job = take(own);
+            if (job) {
+                execute(*job, own);
+                continue;
+            }
+            unique_lock<mutex> lock(sleepMutex);
+            jobFinished.wait(lock, [this, &condition]() { return queuedJobs > 0 || condition(); });
+        }
+    }
+};
+
+// the scheduler shared by loading and the frame
+inline JobSystem& jobSystem()
+{
+    static JobSystem system;
+    return system;
+}
+#endif
@@ -1,6 +1,12 @@
 #version 330 core
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 BrightColor;
+layout (location = 2) out vec2 Velocity;
+
+in vec4 CurrentClipPos;
+in vec4 PreviousClipPos;
+
+#include "velocity.glsl"
 
 void main()
 {           
@@ -10,4 +16,5 @@ void main()
         BrightColor = vec4(FragColor.rgb, 1.0);
 	else
 		BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+    Velocity = ScreenVelocity(CurrentClipPos, PreviousClipPos);
 }
\ No newline at end of file
@@ -1,13 +1,15 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
-layout (std140) uniform Matrices {
-    mat4 projection;
-    mat4 view;
-};
-uniform mat4 model;
+out vec4 CurrentClipPos;
+out vec4 PreviousClipPos;
+
+#include "frame_data.glsl"
 
 void main()
 {
     gl_Position = projection * view * model * vec4(aPos, 1.0);
+    // the motion of the light itself is left out, only the camera's counts
+    CurrentClipPos = gl_Position - vec4(jitter.xy * gl_Position.w, 0.0, 0.0);
+    PreviousClipPos = previousViewProjection * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -74,88 +74,16 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec2 texCoords);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir, vec2 texCoords);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec2 texCoords);
 
-// array of offset direction for sampling
-vec3 gridSamplingDisk[20] = vec3[]
-(
-   vec3(1, 1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1, 1,  1), 
-   vec3(1, 1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1, 1, -1),
-   vec3(1, 1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1, 1,  0),
-   vec3(1, 0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1, 0, -1),
-   vec3(0, 1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0, 1, -1)
-);
-
-float ShadowCalculation(vec3 lightPos_world) {
-    // get vector between fragment position and light position
-    vec3 fragToLight = WorldFragPos - lightPos_world;
-    // now get current linear depth as the length between the fragment and light position
-    float currentDepth = length(fragToLight);
-
-    float shadow = 0.0;
-    float bias = 0.15;
-    int samples = 20;
-    float viewDistance = length(viewPos_world - WorldFragPos);
-    float diskRadius = (1.0 + (viewDistance / far_plane)) / 25.0;
-    for(int i = 0; i < samples; ++i) {
-        float closestDepth = texture(shadowMap, fragToLight + gridSamplingDisk[i] * diskRadius).r;
-        closestDepth *= far_plane;   // undo mapping [0;1]
-        if (currentDepth - bias > closestDepth)
-            shadow += 1.0;
-    }
-    shadow /= float(samples);
-    
-    // display closestDepth as debug (to visualize depth cubemap)
-    // FragColor = vec4(vec3(closestDepth / far_plane), 1.0); 
-
-    return shadow;
-}
-
-vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir_tangent) { 
-    // number of depth layers
-    const float minLayers = 10;
-    const float maxLayers = 20;
-    float numLayers = mix(maxLayers, minLayers, abs(dot(vec3(0.0, 0.0, 1.0), viewDir_tangent)));  
-    // calculate the size of each layer
-    float layerDepth = 1.0 / numLayers;
-    // depth of current layer
-    float currentLayerDepth = 0.0;
-    // the amount to shift the texture coordinates per layer (from vector P)
-    vec2 P = viewDir_tangent.xy / viewDir_tangent.z * height_scale; 
-    vec2 deltaTexCoords = P / numLayers;
-  
-    // get initial values
-    vec2  currentTexCoords = texCoords;
-    float currentDepthMapValue = texture(material.texture_height1, currentTexCoords).r;
-      
-    while(currentLayerDepth < currentDepthMapValue) {
-        // shift texture coordinates along direction of P
-        currentTexCoords -= deltaTexCoords;
-        // get depthmap value at current texture coordinates
-        currentDepthMapValue = texture(material.texture_height1, currentTexCoords).r;  
-        // get depth of next layer
-        currentLayerDepth += layerDepth;  
-    }
-    
-    // -- parallax occlusion mapping interpolation from here on
-    // get texture coordinates before collision (reverse operations)
-    vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
-
-    // get depth after and before collision for linear interpolation
-    float afterDepth  = currentDepthMapValue - currentLayerDepth;
-    float beforeDepth = texture(material.texture_height1, prevTexCoords).r - currentLayerDepth + layerDepth;
- 
-    // interpolation of texture coordinates
-    float weight = afterDepth / (afterDepth - beforeDepth);
-    vec2 finalTexCoords = prevTexCoords * weight + currentTexCoords * (1.0 - weight);
-
-    return finalTexCoords;
-}
+#include "shadow_sampling.glsl"
+#define PARALLAX_DEPTH(uv) texture(material.texture_height1, uv).r
+#include "parallax_mapping.glsl"
 
 void main() {
     vec3 viewDir_tangent = normalize(TangentViewPos - TangentFragPos);
 
     vec2 texCoords = TexCoords;
     if (parallax)
-        texCoords = ParallaxMapping(TexCoords,  viewDir_tangent);
+        texCoords = ParallaxMapping(TexCoords, viewDir_tangent, height_scale);
     // discards a fragment when sampling outside default texture region (fixes border artifacts)
     if (texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
         discard;
@@ -209,7 +137,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal_tangent, vec3 viewDir_tangent,
     // shadow
     float shadow = 0.0;
     if (shadows) 
-        shadow = ShadowCalculation(light.position_world);       
+        shadow = ShadowCalculation(light.position_world, viewPos_world, far_plane);       
     // attenuation
     float distance = length(light.position_world - WorldFragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
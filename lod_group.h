@@ -0,0 +1,85 @@
+#ifndef LOD_GROUP_H
+#define LOD_GROUP_H
+
+#include <glm/glm.hpp>
+
+#include "model.h"
+
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+// Levels of detail of one model, finest first. Every instance picks its level from the projected size of the
+// model's bounding sphere. A level is kept while the size stays within a band of +-hysteresis around the
+// thresholds, so instances near a threshold don't switch back and forth every frame.
+class LODGroup
+{
+public:
+    vector<Model*> levels;
+    // smallest projected size (diameter as a fraction of the viewport height) at which each level is used
+    vector<float> minScreenSizes;
+    float hysteresis = 0.1f;
+    // number of node transforms recomputed by the last update
+    unsigned int updatedNodes = 0;
+
+    // adds the next coarser level, models that failed to load are left out
+    void addLevel(Model* model, float minScreenSize) {
+        if (model->meshes.empty())
+            return;
+        levels.push_back(model);
+        minScreenSizes.push_back(minScreenSize);
+    }
+
+    // updates the node transforms of all levels
+    void update() {
+        updatedNodes = 0;
+        for (unsigned int i = 0; i < levels.size(); i++) {
+            levels[i]->nodes.update();
+            updatedNodes += levels[i]->nodes.updatedNodes;
+        }
+    }
+
+    // the largest number of meshes of a level, so instances can reserve ids in the occlusion culler
+    unsigned int maxMeshCount() const {
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < levels.size(); i++)
+            count = std::max(count, static_cast<unsigned int>(levels[i]->meshes.size()));
+        return count;
+    }
+
+    // makes room for the levels of instances 0 ... count - 1, after that they can be selected from several threads
+    // at once (every instance by one thread)
+    void reserveInstances(unsigned int count) {
+        if (count > instanceLevels.size())
+            instanceLevels.resize(count, 0);
+    }
+
+    // selects the level of an instance. projectionScale is projection[1][1] of the camera.
+    Model& select(unsigned int instance, const glm::mat4& model, const glm::vec3& viewPos, float projectionScale) {
+        if (instance >= instanceLevels.size())
+            instanceLevels.resize(instance + 1, 0);
+        const Model& finest = *levels[0];
+        float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        float distance = glm::length(glm::vec3(model * glm::vec4(finest.center, 1.0f)) - viewPos);
+        float radius = finest.radius * scale;
+        // inside the bounding sphere the model covers the whole screen
+        float screenSize = distance > radius ? radius * projectionScale / distance : 1e30f;
+
+        unsigned int level = std::min(instanceLevels[instance], static_cast<unsigned int>(levels.size() - 1));
+        while (level > 0 && screenSize > minScreenSizes[level - 1] * (1.0f + hysteresis))
+            level--;
+        while (level + 1 < levels.size() && screenSize < minScreenSizes[level] * (1.0f - hysteresis))
+            level++;
+        instanceLevels[instance] = level;
+        return *levels[level];
+    }
+
+    // level selected for an instance by the last select
+    unsigned int levelOf(unsigned int instance) const {
+        return instance < instanceLevels.size() ? instanceLevels[instance] : 0;
+    }
+
+private:
+    vector<unsigned int> instanceLevels;
+};
+#endif
@@ -0,0 +1,22 @@
+#version 330 core
+out float LogLuminance;
+
+in vec2 TexCoords;
+
+uniform sampler2D hdrImage;
+// the scene covers only this part of the image with dynamic resolution
+uniform vec2 renderScale;
+
+void main()
+{
+    // four bilinear taps spread over the block of the hdr image this texel covers (the target is 256x256)
+    vec2 uv = TexCoords * renderScale;
+    vec2 offset = vec2(0.25 / 256.0) * renderScale;
+    vec3 color = texture(hdrImage, uv + vec2(-offset.x, -offset.y)).rgb
+               + texture(hdrImage, uv + vec2(offset.x, -offset.y)).rgb
+               + texture(hdrImage, uv + vec2(-offset.x, offset.y)).rgb
+               + texture(hdrImage, uv + vec2(offset.x, offset.y)).rgb;
+    float luminance = dot(color * 0.25, vec3(0.2126, 0.7152, 0.0722));
+    // the mip chain averages these, so its last level is the log of the geometric mean
+    LogLuminance = log2(max(luminance, 1e-4));
+}
@@ -8,6 +8,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "shader_permutations.h"
+#include "gl_state.h"
 
 #include <string>
 #include <vector>
@@ -46,6 +48,13 @@ public:
     unsigned int VAO;
     bool emissive = false;
     bool opacity = false;
+    // identifies the texture set bound by this mesh, used to sort draw calls by material
+    unsigned int materialID = 0;
+    // bounding volumes in model space, computed at load: box (center and half extents) and sphere around the same center.
+    // used to sort draw calls by depth and to cull meshes outside the view
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 extents = glm::vec3(0.0f);
+    float radius = 0.0f;
 
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
@@ -54,25 +63,37 @@ public:
         this->indices = indices;
         this->textures = textures;
 
+        computeBounds();
+
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
 
     // render the mesh
     void Draw(Shader& shader) {
+        bindMaterial(shader);
+        drawGeometry();
+
+        // always good practice to set everything back to defaults once configured.
+        glState().activeTexture(GL_TEXTURE0);
+    }
+
+    // shader features the material needs, see ShaderPermutations
+    unsigned int shaderFeatures() const {
+        return (emissive ? SHADER_EMISSIVE : 0) | (opacity ? SHADER_OPACITY : 0);
+    }
+
+    // binds the textures of the mesh to the given shader, the shader variant has to match shaderFeatures()
+    void bindMaterial(Shader& shader) {
         // bind appropriate textures
         unsigned int albedoNr = 1;
         //unsigned int specularNr = 1;
         unsigned int normalNr = 1;
-        unsigned int metallicNr = 1;
-        unsigned int roughnessNr = 1;
-        unsigned int aoNr = 1;
-        unsigned int heightNr = 1;
+        unsigned int ormNr = 1;
         unsigned int emissiveNr = 1;
         unsigned int opacityNr = 1;
         // unsigned int reflectionNr = 1;
         for (unsigned int i = 0; i < textures.size(); i++) {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -82,14 +103,8 @@ public:
             //    number = std::to_string(specularNr++); // transfer unsigned int to string
             else if (name == "texture_normal")
                 number = std::to_string(normalNr++); // transfer unsigned int to string
-            else if (name == "texture_metallic")
-                number = std::to_string(metallicNr++);
-            else if (name == "texture_roughness")
-                number = std::to_string(roughnessNr++);
-            else if (name == "texture_ao")
-                number = std::to_string(aoNr++);
-            else if (name == "texture_normal")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
+            else if (name == "texture_orm")
+                number = std::to_string(ormNr++); // ao, roughness, metallic and height packed into one texture
             else if (name == "texture_emissive")
                 number = std::to_string(emissiveNr++);
             else if (name == "texture_opacity")
@@ -99,26 +114,38 @@ public:
 
             // now set the sampler to the correct texture unit
             glUniform1i(glGetUniformLocation(shader.ID, ("material." + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            // and finally bind the texture (the state cache only activates the unit if the binding changes)
+            glState().bindTexture(i, GL_TEXTURE_2D, textures[i].id);
         }
+    }
 
-        shader.setBoolUniform("hasEmissive", emissive);
-        shader.setBoolUniform("hasOpacity", opacity);
-
-        // draw mesh
-        glBindVertexArray(VAO);
+    // issues the draw call of the mesh with whatever material is currently bound
+    void drawGeometry() {
+        glState().bindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
 private:
     // render data 
     unsigned int VBO, EBO;
 
+    // computes the bounding box and the bounding sphere around the box center
+    void computeBounds()
+    {
+        if (vertices.empty())
+            return;
+        glm::vec3 minPos = vertices[0].Position;
+        glm::vec3 maxPos = vertices[0].Position;
+        for (unsigned int i = 1; i < vertices.size(); i++) {
+            minPos = glm::min(minPos, vertices[i].Position);
+            maxPos = glm::max(maxPos, vertices[i].Position);
+        }
+        center = (minPos + maxPos) * 0.5f;
+        extents = (maxPos - minPos) * 0.5f;
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            radius = glm::max(radius, glm::length(vertices[i].Position - center));
+    }
+
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
@@ -127,9 +154,9 @@ private:
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        glState().bindVertexArray(VAO);
         // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
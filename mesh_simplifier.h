@@ -0,0 +1,206 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// symmetric 4x4 error quadric of Garland and Heckbert, stored as its 10 unique coefficients
+struct Quadric {
+    double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0, b2 = 0.0, bc = 0.0, bd = 0.0, c2 = 0.0, cd = 0.0, d2 = 0.0;
+
+    Quadric() {}
+
+    // quadric of the plane ax + by + cz + d = 0
+    Quadric(double a, double b, double c, double d) :
+        a2(a * a), ab(a * b), ac(a * c), ad(a * d), b2(b * b), bc(b * c), bd(b * d), c2(c * c), cd(c * d), d2(d * d) {}
+
+    void add(const Quadric& q) {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2;
+        bc += q.bc; bd += q.bd; c2 += q.c2; cd += q.cd; d2 += q.d2;
+    }
+
+    // sum of the squared distances of p to the planes of the quadric
+    double error(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        return a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+             + b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+             + c2 * z * z + 2.0 * cd * z + d2;
+    }
+};
+
+// Simplifies a triangle mesh by collapsing edges in the order of their quadric error, until only targetRatio of
+// the triangles is left or the next collapse would move the surface by more than maxError (in model units).
+// A vertex is always collapsed onto one of its neighbours, so the vertex attributes stay valid. Vertices with
+// the same position, normal and uv are welded first (a mesh read without aiProcess_JoinIdenticalVertices has one
+// per triangle corner). Vertices on borders and on uv/normal seams (several different vertices at one position)
+// are never moved, which keeps the silhouette and the texture layout intact. The result only contains the
+// vertices that are still used.
+inline void simplifyMesh(const vector<Vertex>& vertices, const vector<unsigned int>& indices, float targetRatio, float maxError,
+    vector<Vertex>& outVertices, vector<unsigned int>& outIndices)
+{
+    const unsigned int vertexCount = static_cast<unsigned int>(vertices.size());
+    vector<unsigned int> current = indices;
+    size_t targetTriangles = static_cast<size_t>(indices.size() / 3 * targetRatio);
+
+    // the first of the vertices with the same attributes stands for all of them
+    map<tuple<float, float, float, float, float, float, float, float>, unsigned int> uniqueVertices;
+    vector<unsigned int> weldedOf(vertexCount);
+    for (unsigned int i = 0; i < vertexCount; i++) {
+        const Vertex& v = vertices[i];
+        auto key = make_tuple(v.Position.x, v.Position.y, v.Position.z, v.Normal.x, v.Normal.y, v.Normal.z, v.TexCoords.x, v.TexCoords.y);
+        weldedOf[i] = uniqueVertices.insert(make_pair(key, i)).first->second;
+    }
+    for (size_t i = 0; i < current.size(); i++)
+        current[i] = weldedOf[current[i]];
+
+    // welded vertices sharing a position belong to the same point of the surface, there is more than one at a seam
+    vector<unsigned int> positionOf(vertexCount);
+    vector<unsigned int> verticesAtPosition;
+    map<tuple<float, float, float>, unsigned int> positions;
+    for (unsigned int i = 0; i < vertexCount; i++) {
+        const glm::vec3& p = vertices[i].Position;
+        auto inserted = positions.insert(make_pair(make_tuple(p.x, p.y, p.z), static_cast<unsigned int>(verticesAtPosition.size())));
+        if (inserted.second)
+            verticesAtPosition.push_back(0);
+        positionOf[i] = inserted.first->second;
+        if (weldedOf[i] == i)
+            verticesAtPosition[positionOf[i]]++;
+    }
+
+    // plane quadrics of the triangles around every position, and the number of triangles on every edge
+    vector<Quadric> quadrics(verticesAtPosition.size());
+    map<pair<unsigned int, unsigned int>, unsigned int> edgeUse;
+    for (size_t t = 0; t + 2 < current.size(); t += 3) {
+        glm::vec3 p0 = vertices[current[t]].Position, p1 = vertices[current[t + 1]].Position, p2 = vertices[current[t + 2]].Position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length > 0.0f) {
+            normal /= length;
+            Quadric plane(normal.x, normal.y, normal.z, -glm::dot(normal, p0));
+            for (int k = 0; k < 3; k++)
+                quadrics[positionOf[current[t + k]]].add(plane);
+        }
+        for (int k = 0; k < 3; k++) {
+            unsigned int a = positionOf[current[t + k]], b = positionOf[current[t + (k + 1) % 3]];
+            edgeUse[make_pair(std::min(a, b), std::max(a, b))]++;
+        }
+    }
+    // borders and non-manifold edges lock their end points, as do seams
+    vector<char> lockedPosition(verticesAtPosition.size(), 0);
+    for (auto it = edgeUse.begin(); it != edgeUse.end(); ++it) {
+        if (it->second != 2)
+            lockedPosition[it->first.first] = lockedPosition[it->first.second] = 1;
+    }
+    vector<char> locked(vertexCount);
+    for (unsigned int i = 0; i < vertexCount; i++)
+        locked[i] = lockedPosition[positionOf[i]] || verticesAtPosition[positionOf[i]] > 1;
+
+    struct Collapse {
+        double cost;
+        unsigned int from, to;
+        bool operator<(const Collapse& other) const { return cost < other.cost; }
+    };
+    const double maxCost = static_cast<double>(maxError) * maxError;
+    // every pass collapses a set of independent edges, cheapest first
+    for (int pass = 0; pass < 32 && current.size() / 3 > targetTriangles; pass++) {
+        vector<Collapse> collapses;
+        vector<vector<unsigned int> > triangles(vertexCount);
+        for (size_t t = 0; t + 2 < current.size(); t += 3) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = current[t + k], b = current[t + (k + 1) % 3];
+                triangles[a].push_back(static_cast<unsigned int>(t));
+                Quadric q = quadrics[positionOf[a]];
+                q.add(quadrics[positionOf[b]]);
+                if (!locked[a]) {
+                    Collapse c = { q.error(vertices[b].Position), a, b };
+                    collapses.push_back(c);
+                }
+                if (!locked[b]) {
+                    Collapse c = { q.error(vertices[a].Position), b, a };
+                    collapses.push_back(c);
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end());
+
+        // an interior collapse removes two triangles
+        size_t wanted = (current.size() / 3 - targetTriangles + 1) / 2;
+        size_t done = 0;
+        vector<unsigned int> remap(vertexCount);
+        for (unsigned int i = 0; i < vertexCount; i++)
+            remap[i] = i;
+        vector<char> touched(vertexCount, 0);
+        for (size_t i = 0; i < collapses.size() && done < wanted; i++) {
+            const Collapse& c = collapses[i];
+            if (c.cost > maxCost)
+                break;
+            if (touched[c.from] || touched[c.to])
+                continue;
+            // reject collapses that flip or degenerate one of the remaining triangles around the vertex
+            bool valid = true;
+            const vector<unsigned int>& around = triangles[c.from];
+            for (unsigned int j = 0; j < around.size() && valid; j++) {
+                unsigned int t = around[j];
+                if (current[t] == c.to || current[t + 1] == c.to || current[t + 2] == c.to)
+                    continue;
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; k++) {
+                    before[k] = vertices[current[t + k]].Position;
+                    after[k] = current[t + k] == c.from ? vertices[c.to].Position : before[k];
+                }
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter))
+                    valid = false;
+            }
+            if (!valid)
+                continue;
+            remap[c.from] = c.to;
+            quadrics[positionOf[c.to]].add(quadrics[positionOf[c.from]]);
+            // the neighbourhood changed, it is evaluated again in the next pass
+            for (unsigned int j = 0; j < around.size(); j++) {
+                for (int k = 0; k < 3; k++)
+                    touched[current[around[j] + k]] = 1;
+            }
+            done++;
+        }
+        if (done == 0)
+            break;
+
+        // apply the collapses and drop the triangles that became degenerate
+        vector<unsigned int> next;
+        next.reserve(current.size());
+        for (size_t t = 0; t + 2 < current.size(); t += 3) {
+            unsigned int a = remap[current[t]], b = remap[current[t + 1]], c = remap[current[t + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            next.push_back(a);
+            next.push_back(b);
+            next.push_back(c);
+        }
+        current.swap(next);
+    }
+
+    // keep only the vertices that are still referenced
+    vector<int> newIndex(vertexCount, -1);
+    outVertices.clear();
+    outIndices.clear();
+    outIndices.reserve(current.size());
+    for (size_t i = 0; i < current.size(); i++) {
+        unsigned int v = current[i];
+        if (newIndex[v] < 0) {
+            newIndex[v] = static_cast<int>(outVertices.size());
+            outVertices.push_back(vertices[v]);
+        }
+        outIndices.push_back(static_cast<unsigned int>(newIndex[v]));
+    }
+}
+#endif
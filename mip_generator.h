@@ -0,0 +1,230 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MIP_GENERATOR_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// Mip chains of 8 bit rgba images generated on the CPU, used instead of glGenerateMipmap (a box filter that
+// averages sRGB values and shortens normals). Every level is filtered from the previous one with a separable
+// Kaiser windowed sinc in float, the texture coordinates wrap like the GL_REPEAT textures of the models.
+
+// how the channels of an image are filtered
+enum MipFilter {
+    MIP_LINEAR = 0, // data maps (opacity, ao/roughness/metallic/height): the values are filtered as they are
+    MIP_COLOR,      // albedo and emissive maps: rgb is sRGB encoded and filtered in linear space, alpha as it is
+    MIP_NORMAL      // tangent space normal maps: the filtered normals are normalized again
+};
+
+// an rgba image with all its mip levels, level 0 first
+struct MipChain {
+    unsigned int width = 0, height = 0;
+    vector<vector<unsigned char> > levels;
+
+    unsigned int levelWidth(unsigned int level) const { return std::max(1u, width >> level); }
+    unsigned int levelHeight(unsigned int level) const { return std::max(1u, height >> level); }
+};
+
+// half width of the filter in texels of the smaller level, and the shape parameter of the Kaiser window
+const float MIP_FILTER_RADIUS = 2.0f;
+const float MIP_KAISER_ALPHA = 4.0f;
+
+// modified Bessel function of the first kind of order 0, the series converges quickly for the used range
+inline float besselI0(float x) {
+    float sum = 1.0f, term = 1.0f, halfX = x * 0.5f;
+    for (int k = 1; k < 16; k++) {
+        term *= (halfX / k) * (halfX / k);
+        sum += term;
+    }
+    return sum;
+}
+
+// weight of a source texel at distance x (in texels of the smaller level) from the center of a filtered texel
+inline float kaiserWeight(float x) {
+    if (std::fabs(x) >= MIP_FILTER_RADIUS)
+        return 0.0f;
+    const float pi = 3.14159265358979f;
+    float sinc = std::fabs(x) < 1e-5f ? 1.0f : std::sin(pi * x) / (pi * x);
+    float t = x / MIP_FILTER_RADIUS;
+    return sinc * besselI0(MIP_KAISER_ALPHA * std::sqrt(1.0f - t * t)) / besselI0(MIP_KAISER_ALPHA);
+}
+
+// source texels and normalized weights of every texel along one axis when going from size to nextSize.
+// Every texel uses the same number of taps, indices wrap around.
+struct MipKernel {
+    unsigned int taps = 0;
+    vector<unsigned int> indices;
+    vector<float> weights;
+
+    MipKernel(unsigned int size, unsigned int nextSize) {
+        float scale = (float)size / nextSize;
+        taps = (unsigned int)std::ceil(2.0f * MIP_FILTER_RADIUS * scale) + 1;
+        indices.resize(nextSize * taps);
+        weights.resize(nextSize * taps);
+        for (unsigned int i = 0; i < nextSize; i++) {
+            float center = (i + 0.5f) * scale;
+            int first = (int)std::floor(center - MIP_FILTER_RADIUS * scale);
+            float sum = 0.0f;
+            for (unsigned int k = 0; k < taps; k++) {
+                int j = first + (int)k;
+                indices[i * taps + k] = (unsigned int)(((j % (int)size) + (int)size) % (int)size);
+                weights[i * taps + k] = kaiserWeight((j + 0.5f - center) / scale);
+                sum += weights[i * taps + k];
+            }
+            for (unsigned int k = 0; k < taps; k++)
+                weights[i * taps + k] /= sum;
+        }
+    }
+};
+
+// destination += weight * source over count floats, count is a multiple of 4 (whole rgba pixels)
+inline void addScaled(float* destination, const float* source, float weight, size_t count) {
+#ifdef MIP_GENERATOR_SSE
+    __m128 w = _mm_set1_ps(weight);
+    for (size_t i = 0; i < count; i += 4)
+        _mm_storeu_ps(destination + i, _mm_add_ps(_mm_loadu_ps(destination + i), _mm_mul_ps(w, _mm_loadu_ps(source + i))));
+#else
+    for (size_t i = 0; i < count; i++)
+        destination[i] += weight * source[i];
+#endif
+}
+
+// next level of a float rgba image, first along x then along y
+inline vector<float> downsampleLevel(const vector<float>& pixels, unsigned int width, unsigned int height, unsigned int nextWidth, unsigned int nextHeight) {
+    MipKernel horizontal(width, nextWidth), vertical(height, nextHeight);
+    vector<float> rows((size_t)nextWidth * height * 4, 0.0f);
+    for (unsigned int y = 0; y < height; y++) {
+        const float* source = &pixels[(size_t)y * width * 4];
+        float* destination = &rows[(size_t)y * nextWidth * 4];
+        for (unsigned int x = 0; x < nextWidth; x++) {
+            for (unsigned int k = 0; k < horizontal.taps; k++)
+                addScaled(destination + x * 4, source + horizontal.indices[x * horizontal.taps + k] * 4, horizontal.weights[x * horizontal.taps + k], 4);
+        }
+    }
+    // whole rows at once along y
+    vector<float> result((size_t)nextWidth * nextHeight * 4, 0.0f);
+    for (unsigned int y = 0; y < nextHeight; y++) {
+        for (unsigned int k = 0; k < vertical.taps; k++)
+            addScaled(&result[(size_t)y * nextWidth * 4], &rows[(size_t)vertical.indices[y * vertical.taps + k] * nextWidth * 4],
+                vertical.weights[y * vertical.taps + k], (size_t)nextWidth * 4);
+    }
+    return result;
+}
+
+inline float srgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float linearToSRGB(float value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+inline void normalizeNormals(vector<float>& pixels) {
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        float length = std::sqrt(pixels[i] * pixels[i] + pixels[i + 1] * pixels[i + 1] + pixels[i + 2] * pixels[i + 2]);
+        if (length > 1e-6f) {
+            pixels[i] /= length;
+            pixels[i + 1] /= length;
+            pixels[i + 2] /= length;
+        }
+        else {
+            pixels[i] = pixels[i + 1] = 0.0f;
+            pixels[i + 2] = 1.0f;
+        }
+    }
+}
+
+// converts a filtered float level back to 8 bits, the sinc lobes can overshoot so the values are clamped
+inline vector<unsigned char> encodeLevel(const vector<float>& pixels, MipFilter filter) {
+    vector<unsigned char> result(pixels.size());
+    for (size_t i = 0; i < pixels.size(); i++) {
+        float value = pixels[i];
+        if (filter == MIP_COLOR && i % 4 != 3)
+            value = linearToSRGB(std::max(0.0f, value));
+        else if (filter == MIP_NORMAL && i % 4 != 3)
+            value = value * 0.5f + 0.5f;
+        result[i] = (unsigned char)(std::min(1.0f, std::max(0.0f, value)) * 255.0f + 0.5f);
+    }
+    return result;
+}
+
+// generates all levels down to 1x1 of an rgba image
+inline MipChain generateMipChain(const unsigned char* rgba, unsigned int width, unsigned int height, MipFilter filter) {
+    MipChain chain;
+    chain.width = width;
+    chain.height = height;
+    chain.levels.push_back(vector<unsigned char>(rgba, rgba + (size_t)width * height * 4));
+
+    float decode[256];
+    for (int i = 0; i < 256; i++)
+        decode[i] = filter == MIP_COLOR ? srgbToLinear(i / 255.0f) : filter == MIP_NORMAL ? i / 127.5f - 1.0f : i / 255.0f;
+    vector<float> pixels((size_t)width * height * 4);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = i % 4 == 3 ? rgba[i] / 255.0f : decode[rgba[i]];
+    if (filter == MIP_NORMAL)
+        normalizeNormals(pixels);
+
+    while (width > 1 || height > 1) {
+        unsigned int nextWidth = std::max(1u, width / 2), nextHeight = std::max(1u, height / 2);
+        pixels = downsampleLevel(pixels, width, height, nextWidth, nextHeight);
+        if (filter == MIP_NORMAL)
+            normalizeNormals(pixels);
+        chain.levels.push_back(encodeLevel(pixels, filter));
+        width = nextWidth;
+        height = nextHeight;
+    }
+    return chain;
+}
+
+// Toksvig: normals that diverge within the footprint of a texel average to a vector shorter than 1, that
+// variance is moved into the roughness so highlights widen at a distance instead of sparkling. The roughness
+// in the given channel of every level is widened by the normals of the normal map within its texels, the two
+// images may have different sizes.
+inline void applyToksvig(MipChain& chain, int channel, const unsigned char* normalRGBA, unsigned int normalWidth, unsigned int normalHeight) {
+    // summed area table of the decoded normals, so the mean over any rectangle is four lookups
+    const size_t stride = normalWidth + 1;
+    vector<double> table(stride * (normalHeight + 1) * 3, 0.0);
+    for (unsigned int y = 0; y < normalHeight; y++) {
+        for (unsigned int x = 0; x < normalWidth; x++) {
+            const unsigned char* texel = &normalRGBA[((size_t)y * normalWidth + x) * 4];
+            double n[3] = { texel[0] / 127.5 - 1.0, texel[1] / 127.5 - 1.0, texel[2] / 127.5 - 1.0 };
+            double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int c = 0; c < 3; c++) {
+                table[(((y + 1) * stride) + x + 1) * 3 + c] = (length > 1e-6 ? n[c] / length : 0.0)
+                    + table[((y * stride) + x + 1) * 3 + c] + table[(((y + 1) * stride) + x) * 3 + c] - table[((y * stride) + x) * 3 + c];
+            }
+        }
+    }
+    for (unsigned int level = 0; level < chain.levels.size(); level++) {
+        unsigned int width = chain.levelWidth(level), height = chain.levelHeight(level);
+        for (unsigned int y = 0; y < height; y++) {
+            size_t y0 = (size_t)y * normalHeight / height, y1 = std::max(y0 + 1, (size_t)(y + 1) * normalHeight / height);
+            for (unsigned int x = 0; x < width; x++) {
+                size_t x0 = (size_t)x * normalWidth / width, x1 = std::max(x0 + 1, (size_t)(x + 1) * normalWidth / width);
+                double mean[3];
+                for (int c = 0; c < 3; c++)
+                    mean[c] = table[(y1 * stride + x1) * 3 + c] - table[(y0 * stride + x1) * 3 + c] - table[(y1 * stride + x0) * 3 + c] + table[(y0 * stride + x0) * 3 + c];
+                double count = (double)(x1 - x0) * (y1 - y0);
+                float length = (float)(std::sqrt(mean[0] * mean[0] + mean[1] * mean[1] + mean[2] * mean[2]) / count);
+                length = std::min(1.0f, std::max(1e-3f, length));
+                if (length > 0.9999f)
+                    continue;
+                // through the Blinn-Phong exponent of the GGX alpha (alpha = roughness^2)
+                unsigned char& value = chain.levels[level][((size_t)y * width + x) * 4 + channel];
+                float roughness = std::max(value / 255.0f, 0.02f);
+                float alpha2 = roughness * roughness * roughness * roughness;
+                float power = 2.0f / alpha2 - 2.0f;
+                float factor = length / (length + power * (1.0f - length));
+                alpha2 = 2.0f / (factor * power + 2.0f);
+                value = (unsigned char)(std::min(1.0f, std::sqrt(std::sqrt(alpha2))) * 255.0f + 0.5f);
+            }
+        }
+    }
+}
+#endif
@@ -12,16 +12,56 @@
 
 #include "mesh.h"
 #include "shader.h"
+#include "render_queue.h"
+#include "gl_state.h"
+#include "frustum.h"
+#include "scene_graph.h"
+#include "occlusion_culler.h"
+#include "mesh_simplifier.h"
+#include "texture_compression.h"
+#include "texture_packing.h"
+#include "mip_generator.h"
+#include "job_system.h"
+#include "gl_extensions.h"
+#include "upload_ring.h"
+#include "startup_trace.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
+unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false, MipFilter filter = MIP_LINEAR);
+unsigned int PackedTextureFromFiles(const PackedTextureSources& sources);
+void UploadPendingTextures();
+
+// a model file read by assimp, on the job system when it comes from ImportModelAsync
+struct ModelImport {
+    string path;
+    Assimp::Importer importer;
+    const aiScene* scene = nullptr;
+    // the job that reads the file
+    JobSystem::JobHandle job;
+
+    void read(const string& filePath) {
+        TraceScope trace("import " + filePath.substr(filePath.find_last_of('/') + 1));
+        path = filePath;
+        // the corners of adjacent faces share their vertices, which the mesh simplifier relies on
+        scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    }
+};
+
+// starts reading a model file, several files are read at once while the GL thread goes on
+inline shared_ptr<ModelImport> ImportModelAsync(const string& path)
+{
+    shared_ptr<ModelImport> import = make_shared<ModelImport>();
+    import->job = jobSystem().submit([import, path]() { import->read(path); });
+    return import;
+}
 
 class Model
 {
@@ -29,13 +69,66 @@ public:
     // model data 
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
+    SceneGraph      nodes;          // node hierarchy of the file with the transforms of the sub-parts
+    vector<unsigned int> meshNodes; // node of each mesh in the scene graph
+    map<unsigned int, unsigned int> materialIDs; // assimp material index -> material id used for draw sorting
     string directory;
     bool gammaCorrection;
+    // bounding sphere of the whole model in model space, used to select the level of detail
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
 
     // constructor, expects a filepath to a 3D model.
     Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
     {
-        loadModel(path);
+        ModelImport import;
+        import.read(path);
+        loadModel(import);
+    }
+
+    // builds the model of a file read in the background (see ImportModelAsync), waits until it is read
+    Model(ModelImport& import, bool gamma = false) : gammaCorrection(gamma)
+    {
+        {
+            TraceScope trace("wait for import");
+            jobSystem().wait(import.job);
+        }
+        loadModel(import);
+    }
+
+    // generates a simplified level of detail of source with about targetRatio of its triangles, a collapse may
+    // move the surface by at most maxError. Textures, materials and nodes are shared with the source.
+    Model(const Model& source, float targetRatio, float maxError) :
+        textures_loaded(source.textures_loaded), nodes(source.nodes), meshNodes(source.meshNodes), materialIDs(source.materialIDs),
+        directory(source.directory), gammaCorrection(source.gammaCorrection), center(source.center), radius(source.radius)
+    {
+        TraceScope trace("simplify model");
+        // the meshes are simplified in parallel, their buffers are created on the GL thread afterwards
+        unsigned int meshCount = static_cast<unsigned int>(source.meshes.size());
+        vector<vector<Vertex> > simplifiedVertices(meshCount);
+        vector<vector<unsigned int> > simplifiedIndices(meshCount);
+        jobSystem().parallelFor(meshCount, [&](unsigned int i) {
+            simplifyMesh(source.meshes[i].vertices, source.meshes[i].indices, targetRatio, maxError, simplifiedVertices[i], simplifiedIndices[i]);
+        });
+        for (unsigned int i = 0; i < meshCount; i++) {
+            const Mesh& original = source.meshes[i];
+            Mesh m(simplifiedVertices[i], simplifiedIndices[i], original.textures);
+            m.emissive = original.emissive;
+            m.opacity = original.opacity;
+            m.materialID = original.materialID;
+            meshes.push_back(m);
+        }
+        // e.g. all vertices locked as seams, the level would cost as much as its source
+        if (triangleCount() >= source.triangleCount() && source.triangleCount() > 0)
+            cout << "ERROR::SIMPLIFY:: the simplified model has as many triangles as its source (" << source.triangleCount() << ")" << endl;
+    }
+
+    unsigned int triangleCount() const
+    {
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            count += static_cast<unsigned int>(meshes[i].indices.size() / 3);
+        return count;
     }
 
     // draws the model, and thus all its meshes
@@ -45,29 +138,100 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // picks the variants of shaders Submit draws with for the given features, on the GL thread
+    // (see ShaderPermutations::get)
+    void PrepareShaders(ShaderPermutations& shaders, unsigned int features)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            shaders.get(features | meshes[i].shaderFeatures());
+    }
+
+    // queues all meshes of the model instead of drawing them directly. In the main pass, meshes
+    // with an opacity map go to the translucent pass, so they are blended back-to-front.
+    // Meshes are culled against the given frusta (bounding sphere first, then bounding box), the draw item
+    // remembers which of them it intersects so the shadow pass can skip cubemap faces.
+    // Meshes that pass the frustum test go through the occlusion culler if there is one, mesh i of the model is
+    // identified there by firstObjectID + i and its box is collected in candidates. Meshes it culls are still
+    // queued, they are drawn only if their box is visible in this frame's depth (see RenderQueue::execute).
+    // Every mesh is drawn with the variant of shaders for the given features plus the ones of its material.
+    // The world transforms of the nodes have to be up to date, see nodes.update(). Several threads may submit at
+    // once into their own queues once the variants were picked with PrepareShaders.
+    void Submit(RenderQueue& queue, RenderPass pass, ShaderPermutations& shaders, unsigned int features, const glm::mat4& model, const glm::vec3& viewPos, const Frustum* frusta = nullptr, unsigned int frustumCount = 0,
+        const OcclusionCuller* occlusion = nullptr, unsigned int firstObjectID = 0, OcclusionCandidates* candidates = nullptr)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++) {
+            glm::mat4 meshModel = model * nodes.worldTransforms[meshNodes[i]];
+            unsigned int visibleFrusta = RenderQueue::ALL_FRUSTA;
+            unsigned int occlusionID = 0;
+            if (frustumCount > 0) {
+                float scale = glm::max(glm::length(glm::vec3(meshModel[0])), glm::max(glm::length(glm::vec3(meshModel[1])), glm::length(glm::vec3(meshModel[2]))));
+                glm::vec3 center = glm::vec3(meshModel * glm::vec4(meshes[i].center, 1.0f));
+                BoundingBox box = transformBoundingBox(meshModel, meshes[i].center, meshes[i].extents);
+                visibleFrusta = 0;
+                for (unsigned int f = 0; f < frustumCount; f++) {
+                    if (frusta[f].intersects(center, meshes[i].radius * scale) && frusta[f].intersects(box))
+                        visibleFrusta |= 1u << f;
+                }
+                if (visibleFrusta == 0) {
+                    queue.culledItems++;
+                    continue;
+                }
+                if (occlusion && !occlusion->testVisibility(firstObjectID + i, box, *candidates))
+                    occlusionID = firstObjectID + i + 1;
+            }
+            RenderPass meshPass = pass;
+            if (pass != PASS_SHADOW && meshes[i].opacity)
+                meshPass = PASS_TRANSLUCENT;
+            queue.submit(meshPass, shaders.lookup(features | meshes[i].shaderFeatures()), meshes[i], meshModel, viewPos, visibleFrusta, occlusionID);
+        }
+    }
+
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const& path)
+    // stores the meshes of a file read by ASSIMP in the meshes vector.
+    void loadModel(ModelImport& import)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        TraceScope trace("build " + import.path.substr(import.path.find_last_of('/') + 1));
+        const aiScene* scene = import.scene;
         // check for errors
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            cout << "ERROR::ASSIMP:: " << import.importer.GetErrorString() << endl;
             return;
         }
         // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        directory = import.path.substr(0, import.path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        {
+            TraceScope processTrace("process meshes");
+            processNode(scene->mRootNode, scene, SceneGraph::NO_PARENT);
+        }
+        // the job system decoded the images while the meshes were processed
+        UploadPendingTextures();
+        nodes.update();
+        computeBounds();
+    }
+
+    // bounding sphere around the box of all meshes placed by their nodes
+    void computeBounds()
+    {
+        if (meshes.empty())
+            return;
+        glm::vec3 minimum(1e30f), maximum(-1e30f);
+        for (unsigned int i = 0; i < meshes.size(); i++) {
+            BoundingBox box = transformBoundingBox(nodes.worldTransforms[meshNodes[i]], meshes[i].center, meshes[i].extents);
+            minimum = glm::min(minimum, box.center - box.extents);
+            maximum = glm::max(maximum, box.center + box.extents);
+        }
+        center = (minimum + maximum) * 0.5f;
+        radius = glm::length(maximum - center);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene)
+    // The node itself is added to the scene graph with its transform, depth first so parents come before their children.
+    void processNode(aiNode* node, const aiScene* scene, int parent)
     {
+        unsigned int nodeIndex = nodes.addNode(parent, toGlm(node->mTransformation), node->mName.C_Str());
         // process each mesh located at the current node
         for (unsigned int i = 0; i < node->mNumMeshes; i++)
         {
@@ -75,15 +239,25 @@ private:
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
             meshes.push_back(processMesh(mesh, scene));
+            meshNodes.push_back(nodeIndex);
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for (unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, static_cast<int>(nodeIndex));
         }
 
     }
 
+    // assimp matrices are row major, glm matrices are column major
+    static glm::mat4 toGlm(const aiMatrix4x4& m)
+    {
+        return glm::mat4(m.a1, m.b1, m.c1, m.d1,
+                         m.a2, m.b2, m.c2, m.d2,
+                         m.a3, m.b3, m.c3, m.d3,
+                         m.a4, m.b4, m.c4, m.d4);
+    }
+
     Mesh processMesh(aiMesh* mesh, const aiScene* scene)
     {
         // data to fill
@@ -152,28 +326,19 @@ private:
         // normal: texture_normalN
 
         // 1. diffuse/albedo maps
-        vector<Texture> albedoMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_albedo", false);
+        vector<Texture> albedoMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_albedo", false, MIP_COLOR);
         textures.insert(textures.end(), albedoMaps.begin(), albedoMaps.end());
         //// 2. specular maps
         //vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
         //textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal");
+        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal", false, MIP_NORMAL);
         textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-        // metallic
-        std::vector<Texture> matallicMaps = loadMaterialTextures(material, aiTextureType_METALNESS, "texture_metallic");
-        textures.insert(textures.end(), matallicMaps.begin(), matallicMaps.end());
-        // roughness
-        std::vector<Texture> roughnessMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE_ROUGHNESS, "texture_roughness");
-        textures.insert(textures.end(), roughnessMaps.begin(), roughnessMaps.end());
-        // ao
-        std::vector<Texture>aoMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_ao", true);
-        textures.insert(textures.end(), aoMaps.begin(), aoMaps.end());
-        // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        // ao, roughness, metallic and height maps, packed into the channels of one texture
+        std::vector<Texture> ormMaps = loadPackedTexture(material);
+        textures.insert(textures.end(), ormMaps.begin(), ormMaps.end());
         // emissive
-        std::vector<Texture> emissiveMaps = loadMaterialTextures(material, aiTextureType_EMISSIVE, "texture_emissive");
+        std::vector<Texture> emissiveMaps = loadMaterialTextures(material, aiTextureType_EMISSIVE, "texture_emissive", false, MIP_COLOR);
         textures.insert(textures.end(), emissiveMaps.begin(), emissiveMaps.end());
         // opacity
         std::vector<Texture> opacityMaps = loadMaterialTextures(material, aiTextureType_OPACITY, "texture_opacity");
@@ -192,14 +357,96 @@ private:
             m.opacity = true;
             //cout << "opacity" << endl;
         }
+        // meshes sharing an assimp material share the same textures, so they get the same material id
+        if (materialIDs.find(mesh->mMaterialIndex) == materialIDs.end())
+            materialIDs[mesh->mMaterialIndex] = newMaterialID();
+        m.materialID = materialIDs[mesh->mMaterialIndex];
         return m;
     }
 
+    // material ids are unique across all loaded models
+    static unsigned int newMaterialID()
+    {
+        static unsigned int nextMaterialID = 1;
+        return nextMaterialID++;
+    }
+
+    // the texture type a map of the given role is stored as in the material. Blender's older OBJ exporter writes the
+    // normal map as map_Bump, the roughness as map_Ns and the metallic map as refl (see "sp3 blender high
+    // poly.mtl"), assimp reads those as height, shininess and reflection. They are only used that way in materials
+    // without any of the PBR keys map_Kn, map_Pr and map_Pm, where the role height has no map (aiTextureType_NONE).
+    static aiTextureType textureTypeOf(aiMaterial* mat, aiTextureType role)
+    {
+        bool pbrKeys = mat->GetTextureCount(aiTextureType_NORMALS) > 0 || mat->GetTextureCount(aiTextureType_DIFFUSE_ROUGHNESS) > 0
+            || mat->GetTextureCount(aiTextureType_METALNESS) > 0;
+        if (pbrKeys)
+            return role;
+        switch (role) {
+        case aiTextureType_NORMALS:
+            return aiTextureType_HEIGHT;
+        case aiTextureType_DIFFUSE_ROUGHNESS:
+            return aiTextureType_SHININESS;
+        case aiTextureType_METALNESS:
+            return aiTextureType_REFLECTION;
+        case aiTextureType_HEIGHT:
+            // the bump map is the normal map
+            return aiTextureType_NONE;
+        default:
+            return role;
+        }
+    }
+
+    // packs the ao, roughness, metallic and height maps of a material into a single "texture_orm" texture (see
+    // texture_packing.h for the channels). The packing is recorded in the texture path, so materials using the
+    // same maps share the packed texture.
+    vector<Texture> loadPackedTexture(aiMaterial* mat)
+    {
+        vector<Texture> textures;
+        const aiTextureType types[ORM_CHANNELS] = { aiTextureType_AMBIENT, aiTextureType_DIFFUSE_ROUGHNESS, aiTextureType_METALNESS, aiTextureType_HEIGHT };
+        PackedTextureSources sources;
+        for (int channel = 0; channel < ORM_CHANNELS; channel++) {
+            aiTextureType type = textureTypeOf(mat, types[channel]);
+            if (type != aiTextureType_NONE && mat->GetTextureCount(type) > 0) {
+                aiString str;
+                mat->GetTexture(type, 0, &str);
+                sources.paths[channel] = directory + '/' + str.C_Str();
+            }
+        }
+        if (sources.empty())
+            return textures;
+        // the normal map widens the roughness of the smaller mip levels
+        aiTextureType normalType = textureTypeOf(mat, aiTextureType_NORMALS);
+        if (mat->GetTextureCount(normalType) > 0) {
+            aiString str;
+            mat->GetTexture(normalType, 0, &str);
+            sources.normalPath = directory + '/' + str.C_Str();
+        }
+        string key = sources.key();
+        for (unsigned int j = 0; j < textures_loaded.size(); j++) {
+            if (textures_loaded[j].path == key) {
+                textures.push_back(textures_loaded[j]);
+                return textures;
+            }
+        }
+        Texture texture;
+        texture.id = PackedTextureFromFiles(sources);
+        texture.type = "texture_orm";
+        texture.path = key;
+        if (texture.id != 0) {
+            textures.push_back(texture);
+            textures_loaded.push_back(texture);
+        }
+        return textures;
+    }
+
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
     // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName, bool gamma=false)
+    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType role, string typeName, bool gamma=false, MipFilter filter=MIP_LINEAR)
     {
         vector<Texture> textures;
+        aiTextureType type = textureTypeOf(mat, role);
+        if (type == aiTextureType_NONE)
+            return textures;
         for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
@@ -218,7 +465,7 @@ private:
             if (!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory, gamma);
+                texture.id = TextureFromFile(str.C_Str(), this->directory, gamma, filter);
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -230,60 +477,199 @@ private:
 };
 
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
+// uploads the DDS file baked by the TextureBaker for an image, returns 0 if there is none or the format isn't supported
+unsigned int CompressedTextureFromFile(const string& filename, bool gamma)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
+    CompressedImage image;
+    if (!readDDS(filename.substr(0, filename.find_last_of('.')) + ".dds", image))
+        return 0;
+    GLenum internalFormat = 0;
+    switch (image.format) {
+    case FORMAT_BC1:
+        if (glExtensions().textureCompressionS3TC)
+            internalFormat = gamma && glExtensions().textureSRGB ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        break;
+    case FORMAT_BC3:
+        if (glExtensions().textureCompressionS3TC)
+            internalFormat = gamma && glExtensions().textureSRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        break;
+    case FORMAT_BC4:
+        internalFormat = GL_COMPRESSED_RED_RGTC1;
+        break;
+    case FORMAT_BC5:
+        internalFormat = GL_COMPRESSED_RG_RGTC2;
+        break;
+    }
+    if (internalFormat == 0)
+        return 0;
 
     unsigned int textureID;
     glGenTextures(1, &textureID);
+    glState().bindTexture(GL_TEXTURE_2D, textureID);
+    unsigned int width = image.width, height = image.height;
+    for (unsigned int level = 0; level < image.levels.size(); level++) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, (GLsizei)image.levels[level].size(), image.levels[level].data());
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        GLenum internalFormat;
-        if (nrComponents == 1) {
-            format = GL_RED;
-            internalFormat = GL_RED;
-        }
-        else if (nrComponents == 3) {
-            format = GL_RGB;
-            if (gamma) {
-                internalFormat = GL_SRGB;
-            }
-            else {
-                internalFormat = GL_RGB;
-            }
-        }
-        else if (nrComponents == 4) {
-            format = GL_RGBA;
-            if (gamma) {
-                internalFormat = GL_SRGB_ALPHA;
-            }
-            else {
-                internalFormat = GL_RGBA;
-            }
-        }
+// a texture whose image is decoded and filtered by the job system, the id exists from the start
+struct PendingTexture {
+    unsigned int id = 0;
+    string path;
+    GLenum internalFormat = GL_RGBA8;
+    MipChain chain; // empty if the image failed to load
+    // the last job that works on the chain
+    JobSystem::JobHandle job;
+};
+
+vector<shared_ptr<PendingTexture> >& pendingTextures()
+{
+    static vector<shared_ptr<PendingTexture> > pending;
+    return pending;
+}
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+// bytes of a region of the ring the textures are uploaded through
+const GLsizeiptr TEXTURE_UPLOAD_REGION = 4 * 1024 * 1024;
 
+// the ring the mip chains are streamed through, created with the first upload
+UploadRing& textureUploads()
+{
+    static UploadRing ring;
+    if (ring.buffer == 0)
+        ring.init(TEXTURE_UPLOAD_REGION);
+    return ring;
+}
+
+// uploads a level of an rgba mip chain from a pixel unpack buffer, in bands of rows that fit into a region of the
+// ring. While the GPU copies a band, the next ones are written into the other regions.
+void UploadTextureLevel(GLenum internalFormat, unsigned int level, unsigned int width, unsigned int height, const unsigned char* rgba)
+{
+    UploadRing& ring = textureUploads();
+    glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    size_t rowBytes = (size_t)width * 4;
+    unsigned int bandRows = std::max(1u, (unsigned int)(TEXTURE_UPLOAD_REGION / rowBytes));
+    glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.buffer);
+    for (unsigned int y = 0; y < height; y += bandRows) {
+        unsigned int rows = std::min(bandRows, height - y);
+        ring.begin();
+        GLintptr offset = ring.push(rgba + y * rowBytes, rows * rowBytes, 4);
+        ring.upload();
+        // the ring grows (and gets a new buffer) if a band didn't fit
+        glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.buffer);
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, rows, GL_RGBA, GL_UNSIGNED_BYTE, (void*)ring.bufferOffset(offset));
+        ring.end();
+    }
+    glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// uploads the mip chains of all pending textures, each as soon as its jobs are done
+void UploadPendingTextures()
+{
+    TraceScope trace("upload textures");
+    vector<shared_ptr<PendingTexture> >& pending = pendingTextures();
+    for (unsigned int i = 0; i < pending.size(); i++) {
+        const PendingTexture& texture = *pending[i];
+        jobSystem().wait(texture.job);
+        if (texture.chain.levels.empty()) {
+            std::cout << "Texture failed to load at path: " << texture.path << std::endl;
+            continue;
+        }
+        glState().bindTexture(GL_TEXTURE_2D, texture.id);
+        for (unsigned int level = 0; level < texture.chain.levels.size(); level++)
+            UploadTextureLevel(texture.internalFormat, level, texture.chain.levelWidth(level), texture.chain.levelHeight(level), texture.chain.levels[level].data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.chain.levels.size() - 1);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
     }
+    pending.clear();
+}
 
-    return textureID;
+// packs the ORM texture of a material on the job system, the channels are uploaded by UploadPendingTextures.
+// With a normal map, the roughness of the mip levels is widened by the variance of the normals (Toksvig).
+unsigned int PackedTextureFromFiles(const PackedTextureSources& sources)
+{
+    shared_ptr<PendingTexture> texture = make_shared<PendingTexture>();
+    glGenTextures(1, &texture->id);
+    texture->path = sources.key();
+    texture->internalFormat = GL_RGBA8;
+    pendingTextures().push_back(texture);
+    texture->job = jobSystem().submit([texture, sources]() {
+        TraceScope trace("pack texture");
+        vector<unsigned char> rgba;
+        int width, height;
+        if (!packTextures(sources, rgba, width, height))
+            return;
+        texture->chain = generateMipChain(rgba.data(), width, height, MIP_LINEAR);
+    });
+    if (sources.normalPath.empty())
+        return texture->id;
+    // the normal map decodes alongside the packing, the roughness is adjusted once both are done
+    struct NormalMap {
+        unsigned char* data = nullptr;
+        int width = 0, height = 0;
+    };
+    shared_ptr<NormalMap> normals = make_shared<NormalMap>();
+    string normalPath = sources.normalPath;
+    JobSystem::JobHandle decodeNormals = jobSystem().submit([normals, normalPath]() {
+        TraceScope trace("decode normal map");
+        int components;
+        normals->data = stbi_load(normalPath.c_str(), &normals->width, &normals->height, &components, 4);
+    });
+    texture->job = jobSystem().submit([texture, normals]() {
+        TraceScope trace("adjust roughness");
+        if (!normals->data)
+            return;
+        if (!texture->chain.levels.empty())
+            applyToksvig(texture->chain, ORM_ROUGHNESS, normals->data, normals->width, normals->height);
+        stbi_image_free(normals->data);
+    }, { texture->job, decodeNormals });
+    return texture->id;
+}
+
+// Loads an image with a full mip chain. A DDS file baked next to it is uploaded right away, otherwise the image
+// is decoded and filtered on the job system and uploaded by UploadPendingTextures.
+unsigned int TextureFromFile(const char* path, const string& directory, bool gamma, MipFilter filter)
+{
+    string filename = string(path);
+    filename = directory + '/' + filename;
+
+    // prefer the compressed texture with precomputed mips
+    unsigned int compressedID = CompressedTextureFromFile(filename, gamma);
+    if (compressedID != 0)
+        return compressedID;
+
+    shared_ptr<PendingTexture> texture = make_shared<PendingTexture>();
+    glGenTextures(1, &texture->id);
+    texture->path = path;
+    pendingTextures().push_back(texture);
+    texture->job = jobSystem().submit([texture, filename, gamma, filter]() {
+        TraceScope trace("decode texture");
+        int width, height, nrComponents;
+        unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 4);
+        if (!data)
+            return;
+        // the images are expanded to rgba, the internal format keeps only the channels of the file
+        if (nrComponents == 1)
+            texture->internalFormat = GL_RED;
+        else if (nrComponents == 2)
+            texture->internalFormat = GL_RG;
+        else if (nrComponents == 3)
+            texture->internalFormat = gamma ? GL_SRGB : GL_RGB;
+        else
+            texture->internalFormat = gamma ? GL_SRGB_ALPHA : GL_RGBA;
+        texture->chain = generateMipChain(data, width, height, filter);
+        stbi_image_free(data);
+    });
+    return texture->id;
 }
-#endif
\ No newline at end of file
+#endif
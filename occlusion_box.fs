@@ -0,0 +1,6 @@
+#version 330 core
+// nothing is written, the occlusion query only counts the fragments that pass the depth test
+
+void main()
+{
+}
@@ -0,0 +1,14 @@
+#version 330 core
+// a corner of the unit cube, scaled to the box of a mesh the previous results culled
+layout (location = 0) in vec3 aPos;
+
+#include "frame_data.glsl"
+
+uniform vec3 boxCenter;
+uniform vec3 boxExtents;
+
+void main()
+{
+    // the jittered projection of the frame, so the box is tested against the depth the scene was rendered with
+    gl_Position = projection * view * vec4(boxCenter + boxExtents * aPos, 1.0);
+}
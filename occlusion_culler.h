@@ -0,0 +1,327 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "gl_state.h"
+#include "frustum.h"
+#include "upload_ring.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+// the boxes of the objects one thread tested with OcclusionCuller::testVisibility, they are tested against the
+// Hi-Z pyramid once the GL thread added them with addCandidates
+struct OcclusionCandidates {
+    vector<BoundingBox> boxes;
+    vector<unsigned int> objectIDs;
+    // the objects the last results culled, they are tested again against the depth of this frame
+    vector<BoundingBox> occludedBoxes;
+    vector<unsigned int> occludedIDs;
+
+    void clear() {
+        boxes.clear();
+        objectIDs.clear();
+        occludedBoxes.clear();
+        occludedIDs.clear();
+    }
+};
+
+// Occlusion culling against a hierarchical depth buffer (Hi-Z). After the main pass the depth buffer is
+// reduced into a max-depth mip chain, and the bounding boxes of all meshes that passed the frustum test are
+// tested against it in a vertex shader. GL 3.3 has neither compute shaders nor indirect draws, so the results
+// are captured with transform feedback and read back once their fence signaled, usually one frame later.
+// Objects without a current result (new or just back in the frustum) are always drawn, so culling errs on the
+// side of drawing too much. The results are old by the time they are used, so an object they cull isn't dropped:
+// once the visible objects are drawn, its box is tested against the depth of this frame with an occlusion query
+// (testOccluded) and the object is drawn with conditional rendering, i.e. only if the box turned out visible.
+// Objects the camera reveals thus appear in the same frame instead of a few frames late, and the CPU never waits
+// for the queries. Objects are identified by ids the caller keeps stable between frames. The visibility of objects
+// may be tested from several threads between beginFrame and test, each into its own candidate list.
+class OcclusionCuller
+{
+public:
+    static const unsigned int SLOT_COUNT = 3;
+
+    bool enabled = true;
+    // number of candidates tested and of objects the last results culled this frame, the latter are only drawn if
+    // the query of testOccluded passes
+    unsigned int testedItems = 0;
+    unsigned int occludedItems = 0;
+    // number of times a result had to be waited for
+    unsigned int stalls = 0;
+
+    OcclusionCuller() : hiZShader("hiz.vs", "", "hiz.fs"), testShader("occlusion_test.vs", "", "", "Visible"),
+        boxShader("occlusion_box.vs", "", "occlusion_box.fs") {}
+
+    // creates the Hi-Z pyramid for a depth buffer of the given size
+    void init(unsigned int screenWidth, unsigned int screenHeight) {
+        width = screenWidth;
+        height = screenHeight;
+        unsigned int levelWidth = std::max(width / 2, 1u), levelHeight = std::max(height / 2, 1u);
+        glGenTextures(1, &hiZTexture);
+        glState().bindTexture(GL_TEXTURE_2D, hiZTexture);
+        levels = 0;
+        while (true) {
+            glTexImage2D(GL_TEXTURE_2D, levels, GL_R32F, levelWidth, levelHeight, 0, GL_RED, GL_FLOAT, NULL);
+            levels++;
+            if (levelWidth == 1 && levelHeight == 1)
+                break;
+            levelWidth = std::max(levelWidth / 2, 1u);
+            levelHeight = std::max(levelHeight / 2, 1u);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glGenFramebuffers(1, &hiZFBO);
+
+        // the attributes point into the upload ring, at the boxes of the frame (see test)
+        glGenVertexArrays(1, &candidateVAO);
+        glState().bindVertexArray(candidateVAO);
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glState().bindVertexArray(0);
+        glGenBuffers(SLOT_COUNT, resultBuffers);
+
+        // a unit cube as a triangle strip, for the boxes of testOccluded
+        const float cube[] = {
+            -1.0f,  1.0f,  1.0f,   1.0f,  1.0f,  1.0f,  -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,
+             1.0f, -1.0f, -1.0f,   1.0f,  1.0f,  1.0f,   1.0f,  1.0f, -1.0f,  -1.0f,  1.0f,  1.0f,
+            -1.0f,  1.0f, -1.0f,  -1.0f, -1.0f,  1.0f,  -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,
+            -1.0f,  1.0f, -1.0f,   1.0f,  1.0f, -1.0f
+        };
+        glGenVertexArrays(1, &boxVAO);
+        glGenBuffers(1, &boxVBO);
+        glState().bindVertexArray(boxVAO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, boxVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(cube), cube, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glState().bindVertexArray(0);
+
+        hiZShader.use();
+        hiZShader.setIntUniform("sourceDepth", 0);
+        testShader.use();
+        testShader.setIntUniform("hiZ", 0);
+        testShader.setIntUniform("hiZLevels", levels);
+        boxShader.setUniformBlockBinding("FrameData", FRAME_UNIFORM_BINDING);
+    }
+
+    // reads back the results that arrived and starts collecting the candidates of a new frame
+    void beginFrame() {
+        frame++;
+        testedItems = 0;
+        occludedItems = 0;
+        candidates.clear();
+        for (unsigned int i = 1; i <= SLOT_COUNT; i++) {
+            // oldest slot first, so newer results overwrite older ones
+            unsigned int slot = (current + i) % SLOT_COUNT;
+            if (slots[slot].fence && glClientWaitSync(slots[slot].fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+                readResults(slot);
+        }
+    }
+
+    // false if the last results culled the object, it has to be drawn with its query then (see queryOf). The box
+    // is collected in the list to be tested for the next frames.
+    bool testVisibility(unsigned int objectID, const BoundingBox& box, OcclusionCandidates& list) const {
+        if (!enabled)
+            return true;
+        list.boxes.push_back(box);
+        list.objectIDs.push_back(objectID);
+        if (objectID >= testedFrame.size() || testedFrame[objectID] != resultFrame || visible[objectID])
+            return true;
+        list.occludedBoxes.push_back(box);
+        list.occludedIDs.push_back(objectID);
+        return false;
+    }
+
+    // adds the boxes a thread collected to the ones tested this frame
+    void addCandidates(const OcclusionCandidates& list) {
+        candidates.boxes.insert(candidates.boxes.end(), list.boxes.begin(), list.boxes.end());
+        candidates.objectIDs.insert(candidates.objectIDs.end(), list.objectIDs.begin(), list.objectIDs.end());
+        candidates.occludedBoxes.insert(candidates.occludedBoxes.end(), list.occludedBoxes.begin(), list.occludedBoxes.end());
+        candidates.occludedIDs.insert(candidates.occludedIDs.end(), list.occludedIDs.begin(), list.occludedIDs.end());
+        occludedItems += (unsigned int)list.occludedIDs.size();
+    }
+
+    // starts an occlusion query per object the last results culled, drawing its box against the depth buffer of
+    // the bound framebuffer. Called once the visible objects are drawn, with the FrameData of the frame bound.
+    // Boxes the near plane may cut get no query, their objects are always drawn.
+    void testOccluded(const glm::vec3& viewPos, float nearPlane) {
+        const vector<unsigned int>& ids = candidates.occludedIDs;
+        if (!enabled || ids.empty())
+            return;
+        if (queries.size() < ids.size()) {
+            size_t count = queries.size();
+            queries.resize(ids.size());
+            glGenQueries((GLsizei)(ids.size() - count), &queries[count]);
+        }
+        boxShader.use();
+        glState().bindVertexArray(boxVAO);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glState().setDepthMask(false);
+        glState().depthFunc(GL_LEQUAL);
+        for (unsigned int i = 0; i < ids.size(); i++) {
+            const BoundingBox& box = candidates.occludedBoxes[i];
+            if (ids[i] >= objectQueries.size())
+                objectQueries.resize(ids[i] + 1, 0);
+            // the corners of the near plane are less than twice its distance away for fields of view up to 120
+            // degrees, a camera closer than that to the box may see through its clipped faces
+            glm::vec3 outside = glm::max(glm::abs(viewPos - box.center) - box.extents, glm::vec3(0.0f));
+            if (glm::length(outside) <= 2.0f * nearPlane) {
+                objectQueries[ids[i]] = 0;
+                continue;
+            }
+            boxShader.setVec3Uniform("boxCenter", box.center);
+            boxShader.setVec3Uniform("boxExtents", box.extents);
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, queries[i]);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 14);
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            objectQueries[ids[i]] = queries[i];
+        }
+        glState().depthFunc(GL_LESS);
+        glState().setDepthMask(true);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    // the query of an object testOccluded tested this frame, 0 if it has to be drawn without one
+    GLuint queryOf(unsigned int objectID) const {
+        return objectID < objectQueries.size() ? objectQueries[objectID] : 0;
+    }
+
+    // drops all results, e.g. when no depth buffer was available to build the pyramid
+    void invalidate() {
+        resultFrame = 0;
+    }
+
+    // reduces the depth texture of the main pass into the Hi-Z pyramid, drawQuad draws a full screen quad
+    void buildHiZ(GLuint depthTexture, void (*drawQuad)()) {
+        if (!enabled)
+            return;
+        glState().bindFramebuffer(hiZFBO);
+        hiZShader.use();
+        glState().activeTexture(GL_TEXTURE0);
+        unsigned int levelWidth = std::max(width / 2, 1u), levelHeight = std::max(height / 2, 1u);
+        for (int level = 0; level < levels; level++) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, hiZTexture, level);
+            glState().viewport(0, 0, levelWidth, levelHeight);
+            if (level == 0) {
+                glState().bindTexture(GL_TEXTURE_2D, depthTexture);
+            }
+            else {
+                // only the previous level may be read while this one is rendered
+                glState().bindTexture(GL_TEXTURE_2D, hiZTexture);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            }
+            drawQuad();
+            levelWidth = std::max(levelWidth / 2, 1u);
+            levelHeight = std::max(levelHeight / 2, 1u);
+        }
+        glState().bindTexture(GL_TEXTURE_2D, hiZTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glState().bindFramebuffer(0);
+        glState().viewport(0, 0, width, height);
+    }
+
+    // tests this frame's candidates against the pyramid, the results are read back by a later beginFrame. The
+    // boxes are streamed through the upload ring of the frame. The depth covers renderScale of the depth texture
+    // (see DynamicResolution).
+    void test(const glm::mat4& viewProjection, UploadRing& uploads, glm::vec2 renderScale = glm::vec2(1.0f)) {
+        if (!enabled || candidates.boxes.empty())
+            return;
+        Slot& slot = slots[current];
+        if (slot.fence) {
+            // the GPU is more than SLOT_COUNT frames behind, wait for the oldest results
+            stalls++;
+            glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            readResults(current);
+        }
+        GLintptr boxesOffset = uploads.push(&candidates.boxes[0], candidates.boxes.size() * sizeof(BoundingBox), sizeof(float));
+        uploads.upload();
+        GLintptr boxes = uploads.bufferOffset(boxesOffset);
+        glState().bindVertexArray(candidateVAO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, uploads.buffer);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(BoundingBox), (void*)(boxes + offsetof(BoundingBox, center)));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(BoundingBox), (void*)(boxes + offsetof(BoundingBox, extents)));
+        glState().bindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, resultBuffers[current]);
+        glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, candidates.boxes.size() * sizeof(GLint), NULL, GL_STREAM_READ);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, resultBuffers[current]);
+
+        testShader.use();
+        testShader.setMat4Uniform("viewProjection", viewProjection);
+        testShader.setVec2Uniform("renderScale", renderScale);
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, hiZTexture);
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)candidates.boxes.size());
+        glEndTransformFeedback();
+        glDisable(GL_RASTERIZER_DISCARD);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+
+        slot.ids = candidates.objectIDs;
+        slot.frame = frame;
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        testedItems = (unsigned int)candidates.boxes.size();
+        current = (current + 1) % SLOT_COUNT;
+    }
+
+private:
+    struct Slot {
+        GLsync fence = 0;
+        unsigned int frame = 0;
+        vector<unsigned int> ids;
+    };
+
+    Shader hiZShader;
+    Shader testShader;
+    Shader boxShader;
+    unsigned int width = 0, height = 0;
+    int levels = 0;
+    GLuint hiZTexture = 0, hiZFBO = 0;
+    GLuint candidateVAO = 0;
+    GLuint boxVAO = 0, boxVBO = 0;
+    // the queries of testOccluded, and per object id the one it got this frame
+    vector<GLuint> queries;
+    vector<GLuint> objectQueries;
+    GLuint resultBuffers[SLOT_COUNT] = {};
+    Slot slots[SLOT_COUNT];
+    unsigned int current = 0;
+    // frames are counted from 1, a result frame of 0 means there are no results
+    unsigned int frame = 0;
+    unsigned int resultFrame = 0;
+    OcclusionCandidates candidates;
+    // per object id: the frame of its last result and whether it was visible
+    vector<unsigned int> testedFrame;
+    vector<unsigned char> visible;
+
+    void readResults(unsigned int index) {
+        Slot& slot = slots[index];
+        glState().bindBuffer(GL_COPY_READ_BUFFER, resultBuffers[index]);
+        const GLint* results = (const GLint*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, slot.ids.size() * sizeof(GLint), GL_MAP_READ_BIT);
+        if (results) {
+            for (unsigned int i = 0; i < slot.ids.size(); i++) {
+                unsigned int id = slot.ids[i];
+                if (id >= testedFrame.size()) {
+                    testedFrame.resize(id + 1, 0);
+                    visible.resize(id + 1, 1);
+                }
+                testedFrame[id] = slot.frame;
+                visible[id] = results[i] != 0;
+            }
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+            resultFrame = slot.frame;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+    }
+};
+#endif
@@ -0,0 +1,48 @@
+#version 330 core
+// one point per candidate: the world space bounding box of a mesh
+layout (location = 0) in vec3 aCenter;
+layout (location = 1) in vec3 aExtents;
+
+// captured with transform feedback, 1 if the box may be visible
+flat out int Visible;
+
+uniform mat4 viewProjection;
+uniform sampler2D hiZ;
+uniform int hiZLevels;
+// the depth covers only this part of the pyramid with dynamic resolution
+uniform vec2 renderScale;
+
+void main()
+{
+    gl_Position = vec4(0.0);
+    vec3 minNdc = vec3(1.0);
+    vec3 maxNdc = vec3(-1.0);
+    for (int i = 0; i < 8; ++i)
+    {
+        vec3 corner = aCenter + aExtents * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = viewProjection * vec4(corner, 1.0);
+        // boxes crossing the near plane are always visible
+        if (clip.w <= 0.0)
+        {
+            Visible = 1;
+            return;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        minNdc = min(minNdc, ndc);
+        maxNdc = max(maxNdc, ndc);
+    }
+    // screen rectangle of the box in texels of the first level
+    vec2 hiZSize = vec2(textureSize(hiZ, 0)) * renderScale;
+    vec2 minTexel = clamp(minNdc.xy * 0.5 + 0.5, 0.0, 1.0) * hiZSize;
+    vec2 maxTexel = clamp(maxNdc.xy * 0.5 + 0.5, 0.0, 1.0) * hiZSize;
+    // the first level on which the rectangle covers at most 2x2 texels
+    vec2 size = maxTexel - minTexel;
+    int level = clamp(int(ceil(log2(max(max(size.x, size.y), 1.0)))), 0, hiZLevels - 1);
+    ivec2 levelMax = textureSize(hiZ, level) - 1;
+    ivec2 lower = min(ivec2(minTexel) >> level, levelMax);
+    ivec2 upper = min(ivec2(maxTexel) >> level, levelMax);
+    float occluderDepth = max(max(texelFetch(hiZ, lower, level).r, texelFetch(hiZ, ivec2(upper.x, lower.y), level).r),
+                              max(texelFetch(hiZ, ivec2(lower.x, upper.y), level).r, texelFetch(hiZ, upper, level).r));
+    // nearest depth of the box against the farthest depth of the occluders
+    Visible = minNdc.z * 0.5 + 0.5 <= occluderDepth ? 1 : 0;
+}
@@ -0,0 +1,16 @@
+// Helpers shared by the physically based shaders (pbs.fs and disney_pbs.fs).
+
+const float PI = 3.14159265359;
+
+float Pow5(float v) {
+	return v * v * v * v * v;
+}
+
+// ----------------------------------------------------------------------------
+vec3 fresnelSchlick(float cosTheta, vec3 F0) {
+    return F0 + (1.0 - F0) * Pow5(clamp(1.0 - cosTheta, 0.0, 1.0));
+}
+
+vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness) {
+    return F0 + (max(vec3(1.0 - roughness), F0) - F0) * Pow5(1.0 - cosTheta);
+} 
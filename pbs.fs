@@ -47,82 +47,11 @@ uniform samplerCube irradianceMap;
 uniform samplerCube prefilterMap;
 uniform sampler2D   brdfLUT; 
 
-const float PI = 3.14159265359;
+#include "pbr_common.glsl"
 
-// array of offset direction for sampling
-vec3 gridSamplingDisk[20] = vec3[] (
-   vec3(1, 1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1, 1,  1), 
-   vec3(1, 1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1, 1, -1),
-   vec3(1, 1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1, 1,  0),
-   vec3(1, 0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1, 0, -1),
-   vec3(0, 1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0, 1, -1)
-);
-
-float ShadowCalculation(vec3 lightPos_world) {
-    // get vector between fragment position and light position
-    vec3 fragToLight = WorldFragPos - lightPos_world;
-    // now get current linear depth as the length between the fragment and light position
-    float currentDepth = length(fragToLight);
-
-    float shadow = 0.0;
-    float bias = 0.15;
-    int samples = 20;
-    float viewDistance = length(viewPos_world - WorldFragPos);
-    float diskRadius = (1.0 + (viewDistance / far_plane)) / 25.0;
-    for(int i = 0; i < samples; ++i) {
-        float closestDepth = texture(shadowMap, fragToLight + gridSamplingDisk[i] * diskRadius).r;
-        closestDepth *= far_plane;   // undo mapping [0;1]
-        if (currentDepth - bias > closestDepth)
-            shadow += 1.0;
-    }
-    shadow /= float(samples);
-    
-    // display closestDepth as debug (to visualize depth cubemap)
-    // FragColor = vec4(vec3(closestDepth / far_plane), 1.0); 
-
-    return shadow;
-}
-
-vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir_tangent) { 
-    // number of depth layers
-    const float minLayers = 10;
-    const float maxLayers = 20;
-    float numLayers = mix(maxLayers, minLayers, abs(dot(vec3(0.0, 0.0, 1.0), viewDir_tangent)));  
-    // calculate the size of each layer
-    float layerDepth = 1.0 / numLayers;
-    // depth of current layer
-    float currentLayerDepth = 0.0;
-    // the amount to shift the texture coordinates per layer (from vector P)
-    vec2 P = viewDir_tangent.xy / viewDir_tangent.z * height_scale; 
-    vec2 deltaTexCoords = P / numLayers;
-  
-    // get initial values
-    vec2  currentTexCoords = texCoords;
-    float currentDepthMapValue = 1 - texture(material.texture_height1, currentTexCoords).r;
-      
-    while(currentLayerDepth < currentDepthMapValue) {
-        // shift texture coordinates along direction of P
-        currentTexCoords -= deltaTexCoords;
-        // get depthmap value at current texture coordinates
-        currentDepthMapValue = 1 - texture(material.texture_height1, currentTexCoords).r;  
-        // get depth of next layer
-        currentLayerDepth += layerDepth;  
-    }
-    
-    // -- parallax occlusion mapping interpolation from here on
-    // get texture coordinates before collision (reverse operations)
-    vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
-
-    // get depth after and before collision for linear interpolation
-    float afterDepth  = currentDepthMapValue - currentLayerDepth;
-    float beforeDepth = 1 - texture(material.texture_height1, prevTexCoords).r - currentLayerDepth + layerDepth;
- 
-    // interpolation of texture coordinates
-    float weight = afterDepth / (afterDepth - beforeDepth);
-    vec2 finalTexCoords = prevTexCoords * weight + currentTexCoords * (1.0 - weight);
-
-    return finalTexCoords;
-}
+#include "shadow_sampling.glsl"
+#define PARALLAX_DEPTH(uv) (1.0 - texture(material.texture_height1, uv).r)
+#include "parallax_mapping.glsl"
 
 // ----------------------------------------------------------------------------
 float DistributionGGX(vec3 N, vec3 H, float roughness) {
@@ -156,14 +85,6 @@ float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
 
     return ggx1 * ggx2;
 }
-// ----------------------------------------------------------------------------
-vec3 fresnelSchlick(float cosTheta, vec3 F0) {
-    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
-}
-
-vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness) {
-    return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
-} 
 
 // ----------------------------------------------------------------------------
 void main() {
@@ -171,7 +92,7 @@ void main() {
 
     vec2 texCoords = TexCoords;
     if (parallax)
-        texCoords = ParallaxMapping(TexCoords,  viewDir_tangent);
+        texCoords = ParallaxMapping(TexCoords, viewDir_tangent, height_scale);
     // discards a fragment when sampling outside default texture region (fixes border artifacts)
     if (texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
         discard;
@@ -199,7 +120,7 @@ void main() {
         // shadow
         float shadow = 0.0;
         if (shadows) 
-            shadow = ShadowCalculation(pointLights[i].position_world);       
+            shadow = ShadowCalculation(pointLights[i].position_world, viewPos_world, far_plane);       
         // attenuation
         float distance = length(pointLights[i].position_world - WorldFragPos);
         // float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
@@ -10,16 +10,11 @@ out vec2 TexCoords;
 out vec3 TangentLightPos;
 out vec3 TangentViewPos;
 out vec3 TangentFragPos;
+// for the motion vectors of the temporal anti-aliasing
+out vec4 CurrentClipPos;
+out vec4 PreviousClipPos;
 
-layout (std140) uniform Matrices {
-    mat4 projection;
-    mat4 view;
-};
-uniform mat4 model;
-uniform mat4 normalMatrix;
-
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+#include "frame_data.glsl"
 
 void main()
 {
@@ -33,9 +28,11 @@ void main()
     vec3 B = cross(N, T);
     mat3 TBN = transpose(mat3(T, B, N));
 
-    TangentLightPos = TBN * lightPos;
-    TangentViewPos  = TBN * viewPos;
+    TangentLightPos = TBN * lightPos.xyz;
+    TangentViewPos  = TBN * viewPos.xyz;
     TangentFragPos  = TBN * WorldFragPos;
 
     gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    CurrentClipPos = gl_Position - vec4(jitter.xy * gl_Position.w, 0.0, 0.0);
+    PreviousClipPos = previousViewProjection * vec4(WorldFragPos, 1.0);
 }
\ No newline at end of file
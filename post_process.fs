@@ -0,0 +1,84 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// All per pixel post processing in one pass, every stage is compiled in with its HAS_ define (see PostProcessChain).
+// The stages run in the order of PostProcessStage.
+
+uniform sampler2D scene;
+uniform sampler2D bloomBlur;
+// the adapted scene luminance (see AutoExposure)
+uniform sampler2D averageLuminance;
+uniform sampler3D colorGradingLUT;
+// the scene covers only this part of the textures with dynamic resolution, it is upscaled to the output
+uniform vec2 renderScale;
+// the same for the blurred image, it differs from the scene's after the temporal anti-aliasing
+uniform vec2 bloomScale;
+uniform float sharpness;
+
+// the exposure, or the exposure compensation with auto exposure
+uniform float exposure;
+uniform float keyValue;
+uniform float vignetteStrength;
+uniform float lutSize;
+
+vec3 linearToSRGB(vec3 color)
+{
+    return mix(color * 12.92, 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, step(vec3(0.0031308), color));
+}
+
+// interleaved gradient noise in [0, 1), stable per pixel
+float gradientNoise(vec2 position)
+{
+    return fract(52.9829189 * fract(dot(position, vec2(0.06711056, 0.00583715))));
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    // bilinear upscale, the texels outside the rendered part are never blended in
+    vec2 uv = min(TexCoords * renderScale, renderScale - 0.5 * texel);
+    vec3 color = texture(scene, uv).rgb;
+#ifdef HAS_SHARPEN
+    // restores some of the contrast the upscale blurs: the difference to the 4 neighbours is added, limited to
+    // their range so edges don't ring
+    vec3 left = texture(scene, uv - vec2(texel.x, 0.0)).rgb;
+    vec3 right = texture(scene, min(uv + vec2(texel.x, 0.0), renderScale - 0.5 * texel)).rgb;
+    vec3 down = texture(scene, uv - vec2(0.0, texel.y)).rgb;
+    vec3 up = texture(scene, min(uv + vec2(0.0, texel.y), renderScale - 0.5 * texel)).rgb;
+    vec3 lowest = min(min(min(left, right), min(down, up)), color);
+    vec3 highest = max(max(max(left, right), max(down, up)), color);
+    color = clamp(color + sharpness * (4.0 * color - left - right - down - up), lowest, highest);
+#endif
+#ifdef HAS_BLOOM
+    color += texture(bloomBlur, min(TexCoords * bloomScale, bloomScale - 0.5 * texel)).rgb; // additive blending
+#endif
+    float sceneExposure = exposure;
+#ifdef HAS_AUTO_EXPOSURE
+    // maps the average luminance to the key value (middle grey)
+    sceneExposure *= keyValue / texelFetch(averageLuminance, ivec2(0), 0).r;
+#endif
+    color *= sceneExposure;
+#ifdef HAS_TONEMAP
+    color = vec3(1.0) - exp(-color);
+#endif
+#ifdef HAS_VIGNETTE
+    // darkens towards the corners, the corners are 1 away from the center
+    float radius = length(TexCoords - 0.5) * 1.41421356;
+    color *= 1.0 - vignetteStrength * smoothstep(0.4, 1.0, radius);
+#endif
+    color = clamp(color, 0.0, 1.0);
+#ifdef HAS_GAMMA
+    color = linearToSRGB(color);
+#endif
+#ifdef HAS_COLOR_GRADING
+    // through the centers of the outer texels, so 0 and 1 map exactly to the ends of the table
+    color = texture(colorGradingLUT, color * ((lutSize - 1.0) / lutSize) + 0.5 / lutSize).rgb;
+#endif
+#ifdef HAS_DITHER
+    // triangular noise of one 8 bit step against banding in gradients
+    color += (gradientNoise(gl_FragCoord.xy) - gradientNoise(gl_FragCoord.xy + vec2(97.0, 31.0))) / 255.0;
+#endif
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,181 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "stb_image.h"
+
+#include "shader.h"
+#include "shader_permutations.h"
+#include "gl_state.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// The per pixel stages after the scene, in the order they are applied. They are fused into one full screen pass
+// (post_process.fs), so the hdr image is read once and the result written once whatever stages are enabled.
+enum PostProcessStage {
+    POST_SHARPEN = 1 << 0,        // sharpens the upscaled scene when it was rendered below the output resolution
+    POST_BLOOM = 1 << 1,          // adds the blurred bright parts of the scene
+    POST_AUTO_EXPOSURE = 1 << 2,  // exposes by the adapted scene luminance (see AutoExposure)
+    POST_TONEMAP = 1 << 3,        // maps the hdr color to [0, 1]
+    POST_VIGNETTE = 1 << 4,       // darkens the corners
+    POST_GAMMA = 1 << 5,          // sRGB encoding, in the shader so dithering can follow it
+    POST_COLOR_GRADING = 1 << 6,  // 3D lookup table applied to the encoded color
+    POST_DITHER = 1 << 7,         // noise of one 8 bit step against banding
+    POST_STAGE_COUNT = 8
+};
+
+inline const vector<string>& postProcessDefines() {
+    static const vector<string> defines = { "HAS_SHARPEN", "HAS_BLOOM", "HAS_AUTO_EXPOSURE", "HAS_TONEMAP", "HAS_VIGNETTE", "HAS_GAMMA",
+        "HAS_COLOR_GRADING", "HAS_DITHER" };
+    return defines;
+}
+
+// Builds the post processing pass from the enabled stages: every combination is a variant of the uber shader,
+// generated with the defines of its stages the first time it is drawn. Stages that are off cost nothing, e.g.
+// without bloom the blur passes can be skipped and the blurred image isn't read.
+class PostProcessChain
+{
+public:
+    // the exposure, or the exposure compensation with auto exposure
+    float exposure = 1.0f;
+    // the average luminance is exposed to this value with auto exposure (middle grey)
+    float keyValue = 0.18f;
+    float vignetteStrength = 0.25f;
+    float sharpness = 0.2f;
+    // the part of the scene and the bloom textures that was rendered, with dynamic resolution
+    glm::vec2 renderScale = glm::vec2(1.0f);
+    glm::vec2 bloomScale = glm::vec2(1.0f);
+
+    PostProcessChain() : permutations("bloom_final.vs", "", "post_process.fs", (1u << POST_STAGE_COUNT) - 1, postProcessDefines()) {
+        permutations.setup = [](Shader& shader) {
+            shader.use();
+            shader.setIntUniform("scene", 0);
+            shader.setIntUniform("bloomBlur", 1);
+            shader.setIntUniform("averageLuminance", 2);
+            shader.setIntUniform("colorGradingLUT", 3);
+        };
+    }
+
+    // creates a neutral color grading table, needs the GL context
+    void init() {
+        const unsigned int size = 16;
+        vector<unsigned char> table(size * size * size * 3);
+        for (unsigned int b = 0; b < size; b++)
+            for (unsigned int g = 0; g < size; g++)
+                for (unsigned int r = 0; r < size; r++) {
+                    unsigned char* texel = &table[((b * size + g) * size + r) * 3];
+                    texel[0] = (unsigned char)(r * 255 / (size - 1));
+                    texel[1] = (unsigned char)(g * 255 / (size - 1));
+                    texel[2] = (unsigned char)(b * 255 / (size - 1));
+                }
+        glGenTextures(1, &lutTexture);
+        uploadLUT(table.data(), size);
+    }
+
+    void setStage(PostProcessStage stage, bool enabled) {
+        if (enabled)
+            enabledStages |= stage;
+        else
+            enabledStages &= ~(unsigned int)stage;
+    }
+
+    bool hasStage(PostProcessStage stage) const {
+        return (enabledStages & stage) != 0;
+    }
+
+    unsigned int stages() const {
+        return enabledStages;
+    }
+
+    // loads a color grading table stored as a strip of size slices of size x size (a size * size x size image,
+    // blue selects the slice) and enables the color grading stage
+    bool loadColorGradingLUT(const string& path) {
+        int width, height, components;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &components, 3);
+        if (!data) {
+            cout << "ERROR::POST_PROCESS:: failed to load the color grading table " << path << endl;
+            return false;
+        }
+        if (width != height * height) {
+            cout << "ERROR::POST_PROCESS:: " << path << " is not a strip of " << height << " slices" << endl;
+            stbi_image_free(data);
+            return false;
+        }
+        unsigned int size = height;
+        vector<unsigned char> table(size * size * size * 3);
+        for (unsigned int b = 0; b < size; b++)
+            for (unsigned int g = 0; g < size; g++)
+                for (unsigned int r = 0; r < size; r++) {
+                    const unsigned char* source = &data[((size_t)g * width + b * size + r) * 3];
+                    unsigned char* texel = &table[((b * size + g) * size + r) * 3];
+                    texel[0] = source[0];
+                    texel[1] = source[1];
+                    texel[2] = source[2];
+                }
+        stbi_image_free(data);
+        uploadLUT(table.data(), size);
+        setStage(POST_COLOR_GRADING, true);
+        return true;
+    }
+
+    // the variants, for the shader watcher
+    ShaderPermutations& shaders() {
+        return permutations;
+    }
+
+    // compiles the variant of a combination of stages ahead of its first use
+    void prepare(unsigned int stages) {
+        permutations.prepare(stages);
+    }
+
+    // draws the post processed scene into the bound framebuffer, drawQuad draws a full screen quad. Textures of
+    // stages that are off may be 0.
+    void apply(GLuint sceneTexture, GLuint bloomTexture, GLuint luminanceTexture, void (*drawQuad)()) {
+        Shader& shader = permutations.get(enabledStages);
+        shader.use();
+        shader.setFloatUniform("exposure", exposure);
+        shader.setFloatUniform("keyValue", keyValue);
+        shader.setFloatUniform("vignetteStrength", vignetteStrength);
+        shader.setFloatUniform("lutSize", (float)lutSize);
+        shader.setFloatUniform("sharpness", sharpness);
+        shader.setVec2Uniform("renderScale", renderScale);
+        shader.setVec2Uniform("bloomScale", bloomScale);
+        glState().bindTexture(0, GL_TEXTURE_2D, sceneTexture);
+        if (hasStage(POST_BLOOM))
+            glState().bindTexture(1, GL_TEXTURE_2D, bloomTexture);
+        if (hasStage(POST_AUTO_EXPOSURE))
+            glState().bindTexture(2, GL_TEXTURE_2D, luminanceTexture);
+        if (hasStage(POST_COLOR_GRADING))
+            glState().bindTexture(3, GL_TEXTURE_3D, lutTexture);
+        glState().activeTexture(GL_TEXTURE0);
+        // the shader encodes the color itself (POST_GAMMA)
+        glState().setFramebufferSRGB(false);
+        drawQuad();
+    }
+
+private:
+    ShaderPermutations permutations;
+    unsigned int enabledStages = POST_TONEMAP | POST_GAMMA | POST_DITHER;
+    GLuint lutTexture = 0;
+    unsigned int lutSize = 0;
+
+    void uploadLUT(const unsigned char* table, unsigned int size) {
+        lutSize = size;
+        glState().bindTexture(GL_TEXTURE_3D, lutTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB8, size, size, size, 0, GL_RGB, GL_UNSIGNED_BYTE, table);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+};
+#endif
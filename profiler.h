@@ -0,0 +1,80 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Collects named per-frame counters and prints their average over the last report interval.
+// Toggled at runtime, while disabled the counters are still collected but nothing is printed.
+class Profiler
+{
+public:
+    bool enabled = false;
+    // seconds between two reports
+    float reportInterval = 1.0f;
+
+    // sets the value of a counter for the current frame
+    void setCounter(const string& name, double value) {
+        counterFor(name).frameValue = value;
+    }
+
+    // adds to the value of a counter for the current frame
+    void addCounter(const string& name, double value) {
+        counterFor(name).frameValue += value;
+    }
+
+    // accumulates the counters of the finished frame and reports once the interval elapsed
+    void endFrame(float deltaTime) {
+        frames++;
+        elapsed += deltaTime;
+        for (unsigned int i = 0; i < counters.size(); i++) {
+            counters[i].sum += counters[i].frameValue;
+            counters[i].frameValue = 0.0;
+        }
+        if (elapsed < reportInterval)
+            return;
+        if (enabled)
+            report();
+        for (unsigned int i = 0; i < counters.size(); i++)
+            counters[i].sum = 0.0;
+        frames = 0;
+        elapsed = 0.0f;
+    }
+
+private:
+    struct Counter {
+        string name;
+        double frameValue;
+        double sum;
+    };
+    vector<Counter> counters;
+    unsigned int frames = 0;
+    float elapsed = 0.0f;
+
+    Counter& counterFor(const string& name) {
+        for (unsigned int i = 0; i < counters.size(); i++) {
+            if (counters[i].name == name)
+                return counters[i];
+        }
+        Counter counter = { name, 0.0, 0.0 };
+        counters.push_back(counter);
+        return counters.back();
+    }
+
+    void report() const {
+        cout << "PROFILER:: " << frames << " frames, " << (elapsed * 1000.0f / frames) << " ms/frame";
+        for (unsigned int i = 0; i < counters.size(); i++)
+            cout << " | " << counters[i].name << " " << (counters[i].sum / frames);
+        cout << endl;
+    }
+};
+
+// the profiler of the application
+inline Profiler& profiler()
+{
+    static Profiler instance;
+    return instance;
+}
+#endif
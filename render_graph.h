@@ -0,0 +1,463 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+#include "render_target_pool.h"
+
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// handle of a resource of the frame's graph
+typedef unsigned int RenderResource;
+
+// The passes of a frame and the resources they read and write, declared anew every frame. Executing the graph
+// - culls the passes whose results nobody reads (persistent resources and the default framebuffer always count
+//   as read), e.g. the blur when the bloom stage is off,
+// - orders the passes by their dependencies, keeping passes that draw into the same targets together,
+// - takes the transient targets from the pool right before their first use and hands them back after their last
+//   one, so targets whose lifetimes don't overlap share memory,
+// - binds the framebuffer and viewport of every pass (the GL state cache filters binds that change nothing).
+// The GPU time of every pass is measured with timestamp queries, read without waiting a few frames later.
+class RenderGraph
+{
+public:
+    // frames whose timestamps can be in flight
+    static const unsigned int TIMING_FRAME_COUNT = 4;
+
+    // what a pass does, its resources can be looked up with texture()
+    typedef function<void(RenderGraph&)> Execute;
+
+    // declares the resources of a pass
+    class PassBuilder
+    {
+    public:
+        PassBuilder(RenderGraph& graph, unsigned int pass) : graph(graph), pass(pass) {}
+
+        // the pass samples the resource
+        PassBuilder& read(RenderResource resource) {
+            graph.passes[pass].reads.push_back(resource);
+            return *this;
+        }
+        // the pass writes the resource through framebuffers of its own
+        PassBuilder& write(RenderResource resource) {
+            graph.passes[pass].writes.push_back(resource);
+            return *this;
+        }
+        // the pass draws into the texture, attached in the order of the calls
+        PassBuilder& color(RenderResource resource) {
+            graph.passes[pass].colors.push_back(resource);
+            return write(resource);
+        }
+        PassBuilder& depth(RenderResource resource) {
+            graph.passes[pass].depth = resource;
+            return write(resource);
+        }
+        // the pass draws into an imported framebuffer
+        PassBuilder& target(RenderResource resource) {
+            graph.passes[pass].framebuffer = resource;
+            return write(resource);
+        }
+        // set before the pass runs, the pass may still change it
+        PassBuilder& viewport(unsigned int width, unsigned int height) {
+            graph.passes[pass].viewportWidth = width;
+            graph.passes[pass].viewportHeight = height;
+            return *this;
+        }
+
+    private:
+        RenderGraph& graph;
+        unsigned int pass;
+    };
+
+    // GPU times of the passes of a frame, passes with the same name are summed
+    struct FrameTimes {
+        // the frame's number, see frames
+        unsigned int frame = 0;
+        vector<pair<string, double>> passMilliseconds;
+    };
+
+    // GPU time of the passes of the latest measured frame
+    vector<pair<string, double>> passMilliseconds;
+    // frames declared so far, the current one included
+    unsigned int frames = 0;
+    // with keepMeasuredFrames, every measured frame is queued in measuredFrames until the owner clears it.
+    // Several frames can arrive at once, passMilliseconds only has the latest of them.
+    bool keepMeasuredFrames = false;
+    vector<FrameTimes> measuredFrames;
+    // passes run and culled in the last executed frame
+    unsigned int executedPasses = 0;
+    unsigned int culledPasses = 0;
+
+    explicit RenderGraph(RenderTargetPool& pool) : pool(pool) {}
+
+    ~RenderGraph() {
+        for (unsigned int i = 0; i < TIMING_FRAME_COUNT; i++) {
+            if (!timings[i].queries.empty())
+                glDeleteQueries((GLsizei)timings[i].queries.size(), &timings[i].queries[0]);
+        }
+    }
+
+    // starts the declaration of a new frame
+    void beginFrame() {
+        passes.clear();
+        resources.clear();
+        order.clear();
+        collectTimings();
+        frames++;
+    }
+
+    // a texture of the frame, taken from the pool only if a pass that runs uses it
+    RenderResource createTexture(const string& name, GLenum internalFormat, unsigned int width, unsigned int height, GLenum filter = GL_LINEAR) {
+        Resource resource;
+        resource.name = name;
+        resource.kind = RESOURCE_TRANSIENT;
+        resource.internalFormat = internalFormat;
+        resource.width = width;
+        resource.height = height;
+        resource.filter = filter;
+        return add(resource);
+    }
+
+    // a framebuffer owned outside the graph (0 is the default framebuffer), its texture may be 0
+    RenderResource importFramebuffer(const string& name, GLuint framebuffer, GLuint texture, bool persistent) {
+        Resource resource;
+        resource.name = name;
+        resource.kind = RESOURCE_FRAMEBUFFER;
+        resource.framebuffer = framebuffer;
+        resource.texture = texture;
+        resource.persistent = persistent;
+        return add(resource);
+    }
+
+    // state of a module that binds it itself (e.g. the Hi-Z pyramid), only orders the passes. The writers of a
+    // persistent resource are never culled, its content is used by later frames.
+    RenderResource importResource(const string& name, bool persistent) {
+        Resource resource;
+        resource.name = name;
+        resource.kind = RESOURCE_EXTERNAL;
+        resource.persistent = persistent;
+        return add(resource);
+    }
+
+    PassBuilder addPass(const string& name, Execute execute) {
+        Pass pass;
+        pass.name = name;
+        pass.execute = execute;
+        passes.push_back(pass);
+        return PassBuilder(*this, (unsigned int)passes.size() - 1);
+    }
+
+    // the texture of a resource, transient ones only while a pass that uses them runs
+    GLuint texture(RenderResource resource) const {
+        return resources[resource].texture;
+    }
+
+    // culls, orders and runs the passes declared since beginFrame()
+    void execute() {
+        cull();
+        sort();
+        computeLifetimes();
+
+        TimedFrame* timing = nullptr;
+        if (pendingTimings < TIMING_FRAME_COUNT) {
+            timing = &timings[(oldestTiming + pendingTimings) % TIMING_FRAME_COUNT];
+            timing->names.clear();
+            timing->frame = frames;
+            while (timing->queries.size() < order.size() + 1) {
+                GLuint query;
+                glGenQueries(1, &query);
+                timing->queries.push_back(query);
+            }
+            glQueryCounter(timing->queries[0], GL_TIMESTAMP);
+        }
+
+        for (unsigned int i = 0; i < order.size(); i++) {
+            Pass& pass = passes[order[i]];
+            for (unsigned int j = 0; j < resources.size(); j++) {
+                Resource& resource = resources[j];
+                if (resource.kind == RESOURCE_TRANSIENT && resource.firstUse == i) {
+                    resource.texture = pool.acquire(resource.internalFormat, resource.width, resource.height, resource.filter);
+                }
+            }
+            bindTargets(pass);
+            pass.execute(*this);
+            for (unsigned int j = 0; j < resources.size(); j++) {
+                Resource& resource = resources[j];
+                if (resource.kind == RESOURCE_TRANSIENT && resource.lastUse == i) {
+                    pool.release(resource.texture);
+                    resource.texture = 0;
+                }
+            }
+            if (timing != nullptr) {
+                glQueryCounter(timing->queries[i + 1], GL_TIMESTAMP);
+                timing->names.push_back(pass.name);
+            }
+        }
+        if (timing != nullptr)
+            pendingTimings++;
+        executedPasses = (unsigned int)order.size();
+        culledPasses = (unsigned int)(passes.size() - order.size());
+    }
+
+    // prints the passes of the last executed frame in the order they ran, with their resources and GPU times
+    void dump(ostream& out) const {
+        out << "RENDER_GRAPH:: " << executedPasses << " passes, " << culledPasses << " culled" << endl;
+        for (unsigned int i = 0; i < order.size(); i++) {
+            const Pass& pass = passes[order[i]];
+            out << "  " << setw(2) << i << " " << left << setw(16) << pass.name << right;
+            double milliseconds = timeOf(pass.name);
+            if (milliseconds >= 0.0)
+                out << " " << fixed << setprecision(3) << milliseconds << " ms" << defaultfloat;
+            out << " | reads";
+            printResources(out, pass.reads);
+            out << " | writes";
+            printResources(out, pass.writes);
+            out << endl;
+        }
+        for (unsigned int i = 0; i < passes.size(); i++) {
+            if (!passes[i].alive)
+                out << "  culled " << passes[i].name << endl;
+        }
+        for (unsigned int i = 0; i < resources.size(); i++) {
+            const Resource& resource = resources[i];
+            if (resource.kind != RESOURCE_TRANSIENT)
+                continue;
+            out << "  " << left << setw(16) << resource.name << right << " " << resource.width << "x" << resource.height;
+            if (resource.firstUse == NOT_USED)
+                out << " not allocated" << endl;
+            else
+                out << " passes " << resource.firstUse << "-" << resource.lastUse << endl;
+        }
+    }
+
+private:
+    enum ResourceKind {
+        RESOURCE_TRANSIENT,    // a texture from the pool, lives within the frame
+        RESOURCE_FRAMEBUFFER,  // an imported framebuffer
+        RESOURCE_EXTERNAL      // state of a module, only orders the passes
+    };
+    static const unsigned int NOT_USED = ~0u;
+    static const RenderResource NO_RESOURCE = ~0u;
+
+    struct Resource {
+        string name;
+        ResourceKind kind = RESOURCE_TRANSIENT;
+        GLenum internalFormat = 0;
+        unsigned int width = 0, height = 0;
+        GLenum filter = GL_LINEAR;
+        GLuint texture = 0;
+        GLuint framebuffer = 0;
+        bool persistent = false;
+        // read by a pass that runs later, set while culling
+        bool needed = false;
+        // positions in the execution order
+        unsigned int firstUse = NOT_USED, lastUse = NOT_USED;
+    };
+    struct Pass {
+        string name;
+        Execute execute;
+        vector<RenderResource> reads;
+        vector<RenderResource> writes;
+        vector<RenderResource> colors;
+        RenderResource depth = NO_RESOURCE;
+        RenderResource framebuffer = NO_RESOURCE;
+        unsigned int viewportWidth = 0, viewportHeight = 0;
+        bool alive = false;
+    };
+    struct TimedFrame {
+        unsigned int frame = 0;
+        vector<string> names;
+        vector<GLuint> queries;
+    };
+
+    RenderTargetPool& pool;
+    vector<Resource> resources;
+    vector<Pass> passes;
+    // indices of the passes that run, in their order
+    vector<unsigned int> order;
+    TimedFrame timings[TIMING_FRAME_COUNT];
+    // frames with timestamps in flight are oldestTiming, oldestTiming + 1, ... (mod TIMING_FRAME_COUNT)
+    unsigned int oldestTiming = 0;
+    unsigned int pendingTimings = 0;
+
+    RenderResource add(const Resource& resource) {
+        resources.push_back(resource);
+        return (RenderResource)resources.size() - 1;
+    }
+
+    // walks the passes backwards: a pass runs if it writes a persistent resource or one a later running pass reads
+    void cull() {
+        for (unsigned int i = (unsigned int)passes.size(); i-- > 0;) {
+            Pass& pass = passes[i];
+            pass.alive = false;
+            for (unsigned int j = 0; j < pass.writes.size(); j++) {
+                const Resource& resource = resources[pass.writes[j]];
+                if (resource.persistent || resource.needed)
+                    pass.alive = true;
+            }
+            if (!pass.alive)
+                continue;
+            for (unsigned int j = 0; j < pass.reads.size(); j++)
+                resources[pass.reads[j]].needed = true;
+        }
+    }
+
+    // a pass depends on the earlier passes that wrote what it reads or writes, and on the earlier readers of what
+    // it writes. Of the passes whose dependencies ran, the next one is the first declared that draws into the same
+    // targets as the previous pass, or else the first declared.
+    void sort() {
+        unsigned int count = (unsigned int)passes.size();
+        vector<vector<unsigned int>> dependencies(count);
+        for (unsigned int i = 0; i < count; i++) {
+            if (!passes[i].alive)
+                continue;
+            for (unsigned int j = 0; j < i; j++) {
+                if (passes[j].alive && dependsOn(passes[i], passes[j]))
+                    dependencies[i].push_back(j);
+            }
+        }
+        vector<bool> done(count, false);
+        unsigned int previous = NOT_USED;
+        for (;;) {
+            unsigned int next = NOT_USED;
+            for (unsigned int i = 0; i < count; i++) {
+                if (!passes[i].alive || done[i])
+                    continue;
+                bool ready = true;
+                for (unsigned int j = 0; j < dependencies[i].size(); j++)
+                    ready = ready && done[dependencies[i][j]];
+                if (!ready)
+                    continue;
+                if (next == NOT_USED)
+                    next = i;
+                if (previous != NOT_USED && sameTargets(passes[i], passes[previous])) {
+                    next = i;
+                    break;
+                }
+            }
+            if (next == NOT_USED)
+                break;
+            done[next] = true;
+            order.push_back(next);
+            previous = next;
+        }
+    }
+
+    bool dependsOn(const Pass& pass, const Pass& earlier) const {
+        for (unsigned int i = 0; i < earlier.writes.size(); i++) {
+            if (uses(pass.reads, earlier.writes[i]) || uses(pass.writes, earlier.writes[i]))
+                return true;
+        }
+        for (unsigned int i = 0; i < earlier.reads.size(); i++) {
+            if (uses(pass.writes, earlier.reads[i]))
+                return true;
+        }
+        return false;
+    }
+
+    static bool uses(const vector<RenderResource>& list, RenderResource resource) {
+        for (unsigned int i = 0; i < list.size(); i++) {
+            if (list[i] == resource)
+                return true;
+        }
+        return false;
+    }
+
+    static bool sameTargets(const Pass& a, const Pass& b) {
+        bool drawsA = !a.colors.empty() || a.depth != NO_RESOURCE || a.framebuffer != NO_RESOURCE;
+        return drawsA && a.colors == b.colors && a.depth == b.depth && a.framebuffer == b.framebuffer;
+    }
+
+    void computeLifetimes() {
+        for (unsigned int i = 0; i < order.size(); i++) {
+            const Pass& pass = passes[order[i]];
+            const vector<RenderResource>* lists[] = { &pass.reads, &pass.writes };
+            for (const vector<RenderResource>* list : lists) {
+                for (unsigned int j = 0; j < list->size(); j++) {
+                    Resource& resource = resources[(*list)[j]];
+                    if (resource.firstUse == NOT_USED) {
+                        resource.firstUse = i;
+                        if (resource.kind == RESOURCE_TRANSIENT && list == &pass.reads)
+                            cout << "ERROR::RENDER_GRAPH:: " << pass.name << " reads " << resource.name << " before it is written" << endl;
+                    }
+                    resource.lastUse = i;
+                }
+            }
+        }
+    }
+
+    void bindTargets(const Pass& pass) {
+        if (pass.framebuffer != NO_RESOURCE) {
+            glState().bindFramebuffer(resources[pass.framebuffer].framebuffer);
+        }
+        else if (!pass.colors.empty() || pass.depth != NO_RESOURCE) {
+            vector<GLuint> colors;
+            for (unsigned int i = 0; i < pass.colors.size(); i++)
+                colors.push_back(resources[pass.colors[i]].texture);
+            GLuint depth = pass.depth != NO_RESOURCE ? resources[pass.depth].texture : 0;
+            glState().bindFramebuffer(pool.framebuffer(colors, depth));
+        }
+        if (pass.viewportWidth > 0)
+            glState().viewport(0, 0, pass.viewportWidth, pass.viewportHeight);
+    }
+
+    // reads the timestamps of the frames whose queries are done, never waits for the GPU
+    void collectTimings() {
+        while (pendingTimings > 0) {
+            TimedFrame& timing = timings[oldestTiming];
+            GLint available = 0;
+            glGetQueryObjectiv(timing.queries[timing.names.size()], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            passMilliseconds.clear();
+            GLuint64 previous = 0;
+            glGetQueryObjectui64v(timing.queries[0], GL_QUERY_RESULT, &previous);
+            for (unsigned int i = 0; i < timing.names.size(); i++) {
+                GLuint64 timestamp = 0;
+                glGetQueryObjectui64v(timing.queries[i + 1], GL_QUERY_RESULT, &timestamp);
+                addTime(timing.names[i], (timestamp - previous) / 1000000.0);
+                previous = timestamp;
+            }
+            if (keepMeasuredFrames) {
+                FrameTimes times;
+                times.frame = timing.frame;
+                times.passMilliseconds = passMilliseconds;
+                measuredFrames.push_back(times);
+            }
+            oldestTiming = (oldestTiming + 1) % TIMING_FRAME_COUNT;
+            pendingTimings--;
+        }
+    }
+
+    void addTime(const string& name, double milliseconds) {
+        for (unsigned int i = 0; i < passMilliseconds.size(); i++) {
+            if (passMilliseconds[i].first == name) {
+                passMilliseconds[i].second += milliseconds;
+                return;
+            }
+        }
+        passMilliseconds.push_back(make_pair(name, milliseconds));
+    }
+
+    double timeOf(const string& name) const {
+        for (unsigned int i = 0; i < passMilliseconds.size(); i++) {
+            if (passMilliseconds[i].first == name)
+                return passMilliseconds[i].second;
+        }
+        return -1.0;
+    }
+
+    void printResources(ostream& out, const vector<RenderResource>& list) const {
+        if (list.empty())
+            out << " -";
+        for (unsigned int i = 0; i < list.size(); i++)
+            out << " " << resources[list[i]].name;
+    }
+};
+#endif
@@ -0,0 +1,208 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "shader.h"
+#include "gl_state.h"
+#include "upload_ring.h"
+#include "frustum.h"
+#include "occlusion_culler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// Passes are stored in the top bits of the sort key, so the queue is executed in this order
+enum RenderPass {
+    PASS_SHADOW = 0,
+    PASS_OPAQUE = 1,
+    PASS_TRANSLUCENT = 2
+};
+
+// draw buffer of the motion vectors (location 2 of the scene shaders), it isn't blended
+const unsigned int VELOCITY_DRAW_BUFFER = 2;
+
+// A single draw call collected by the render queue. Items without a mesh call drawFunction instead
+// (used for the procedural geometry like the light cube).
+struct DrawItem {
+    uint64_t key;
+    Shader* shader;
+    Mesh* mesh;
+    void (*drawFunction)();
+    glm::mat4 model;
+    // inverse transpose of model, computed where the item is submitted (possibly on a job thread)
+    glm::mat4 normalMatrix;
+    // offset of the ObjectData block of this item in the upload ring
+    GLintptr objectOffset;
+    // bit mask of the frusta the item intersects (the shadow cubemap faces in the shadow pass)
+    unsigned int visibleFrusta;
+    // id + 1 of the object in the occlusion culler if the last results culled it, 0 otherwise
+    unsigned int occlusionID;
+};
+
+// Collects draw calls for a frame and submits them in an order that minimizes GL state changes. Filling and sorting
+// a queue doesn't touch GL, so job threads can record into queues of their own that are merged for execution.
+// Sort key layout (most significant bit first):
+//   shadow/opaque: | pass : 2 | program : 10 | material : 20 | depth : 24 |   (front-to-back)
+//   translucent:   | pass : 2 | depth : 24 | program : 10 | material : 20 |   (back-to-front)
+// In the shadow pass no material is bound, so the VAO takes the place of the material.
+class RenderQueue
+{
+public:
+    static const unsigned int ALL_FRUSTA = 0x3F;
+
+    vector<DrawItem> items;
+    // far distance used to quantize the depth part of the key
+    float depthRange = 100.0f;
+    // number of program and material binds of the last execute, for comparing with the unsorted order
+    unsigned int programChanges = 0;
+    unsigned int materialChanges = 0;
+    // number of meshes rejected by culling since the last clear
+    unsigned int culledItems = 0;
+
+    void clear() {
+        items.clear();
+        culledItems = 0;
+    }
+
+    // queues a mesh, viewPos is used to compute the depth of the mesh center. A mesh the occlusion culler culled
+    // is drawn only if its query passes, see execute.
+    void submit(RenderPass pass, Shader& shader, Mesh& mesh, const glm::mat4& model, const glm::vec3& viewPos, unsigned int visibleFrusta = ALL_FRUSTA,
+        unsigned int occlusionID = 0) {
+        glm::vec3 center = glm::vec3(model * glm::vec4(mesh.center, 1.0f));
+        unsigned int material = pass == PASS_SHADOW ? mesh.VAO : mesh.materialID;
+        DrawItem item;
+        item.key = makeKey(pass, shader.ID, material, glm::length(center - viewPos));
+        item.shader = &shader;
+        item.mesh = &mesh;
+        item.drawFunction = nullptr;
+        item.model = model;
+        item.normalMatrix = glm::transpose(glm::inverse(model));
+        item.objectOffset = 0;
+        item.visibleFrusta = visibleFrusta;
+        item.occlusionID = occlusionID;
+        items.push_back(item);
+    }
+
+    // queues procedural geometry that doesn't carry a material
+    void submit(RenderPass pass, Shader& shader, void (*drawFunction)(), const glm::mat4& model, const glm::vec3& viewPos) {
+        DrawItem item;
+        item.key = makeKey(pass, shader.ID, 0, glm::length(glm::vec3(model[3]) - viewPos));
+        item.shader = &shader;
+        item.mesh = nullptr;
+        item.drawFunction = drawFunction;
+        item.model = model;
+        item.normalMatrix = glm::transpose(glm::inverse(model));
+        item.objectOffset = 0;
+        item.visibleFrusta = ALL_FRUSTA;
+        item.occlusionID = 0;
+        items.push_back(item);
+    }
+
+    void sort() {
+        std::sort(items.begin(), items.end(), compareKeys);
+    }
+
+    // adds the items of a queue filled by another thread, both queues have to be sorted and this one stays sorted
+    void merge(const RenderQueue& other) {
+        size_t middle = items.size();
+        items.insert(items.end(), other.items.begin(), other.items.end());
+        std::inplace_merge(items.begin(), items.begin() + middle, items.end(), compareKeys);
+        culledItems += other.culledItems;
+    }
+
+    // writes the ObjectData block of every item into the staging copy of the upload ring
+    void packObjects(UploadRing& uniforms) {
+        ObjectUniforms object;
+        for (unsigned int i = 0; i < items.size(); i++) {
+            object.model = items[i].model;
+            object.normalMatrix = items[i].normalMatrix;
+            object.shadowFaces = items[i].visibleFrusta;
+            object.padding[0] = object.padding[1] = object.padding[2] = 0;
+            items[i].objectOffset = uniforms.push(&object, sizeof(ObjectUniforms));
+        }
+    }
+
+    // executes all (sorted) items of the given pass, only rebinding program and material when they change.
+    // packObjects has to be called and the ring uploaded before. Items the occlusion culler culled are skipped
+    // unless it is given, then they are drawn if their query passes (see OcclusionCuller::testOccluded), and
+    // with onlyOccluded only they are drawn.
+    void execute(RenderPass pass, UploadRing& uniforms, const OcclusionCuller* occlusion = nullptr, bool onlyOccluded = false) {
+        programChanges = 0;
+        materialChanges = 0;
+        Shader* currentShader = nullptr;
+        Mesh* currentMaterial = nullptr;
+        if (pass == PASS_TRANSLUCENT) {
+            glState().setBlend(true);
+            // the velocity is a vec2 without alpha, blending it would mix in an undefined alpha. The nearest
+            // translucent surface writes its own motion instead.
+            glDisablei(GL_BLEND, VELOCITY_DRAW_BUFFER);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glState().setDepthMask(false);
+        }
+        for (unsigned int i = 0; i < items.size(); i++) {
+            DrawItem& item = items[i];
+            if (passOf(item.key) != pass)
+                continue;
+            bool occluded = item.occlusionID != 0;
+            if ((occluded && occlusion == nullptr) || (!occluded && onlyOccluded))
+                continue;
+            if (item.shader != currentShader) {
+                item.shader->use();
+                currentShader = item.shader;
+                currentMaterial = nullptr;
+                programChanges++;
+            }
+            uniforms.bindRange(OBJECT_UNIFORM_BINDING, item.objectOffset, sizeof(ObjectUniforms));
+            if (item.mesh) {
+                if (pass != PASS_SHADOW) {
+                    if (currentMaterial == nullptr || currentMaterial->materialID != item.mesh->materialID) {
+                        item.mesh->bindMaterial(*item.shader);
+                        currentMaterial = item.mesh;
+                        materialChanges++;
+                    }
+                }
+                GLuint query = occluded ? occlusion->queryOf(item.occlusionID - 1) : 0;
+                if (query != 0)
+                    glBeginConditionalRender(query, GL_QUERY_WAIT);
+                item.mesh->drawGeometry();
+                if (query != 0)
+                    glEndConditionalRender();
+            }
+            else {
+                item.drawFunction();
+            }
+        }
+        if (pass == PASS_TRANSLUCENT) {
+            glState().setDepthMask(true);
+            glState().setBlend(false);
+        }
+        glState().activeTexture(GL_TEXTURE0);
+    }
+
+private:
+    uint64_t makeKey(RenderPass pass, unsigned int program, unsigned int material, float distance) const {
+        uint64_t depth = static_cast<uint64_t>(glm::clamp(distance / depthRange, 0.0f, 1.0f) * 0xFFFFFF);
+        uint64_t state = (static_cast<uint64_t>(program & 0x3FF) << 20) | (material & 0xFFFFF);
+        uint64_t key = static_cast<uint64_t>(pass) << 62;
+        if (pass == PASS_TRANSLUCENT)
+            key |= ((0xFFFFFF - depth) << 30) | state;
+        else
+            key |= (state << 24) | depth;
+        return key;
+    }
+
+    static bool compareKeys(const DrawItem& a, const DrawItem& b) {
+        return a.key < b.key;
+    }
+
+    static RenderPass passOf(uint64_t key) {
+        return static_cast<RenderPass>(key >> 62);
+    }
+};
+#endif
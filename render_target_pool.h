@@ -0,0 +1,212 @@
+#ifndef RENDER_TARGET_POOL_H
+#define RENDER_TARGET_POOL_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// 2D render target textures handed out by format, size and filter and taken back when a pass is done with
+// them. A released texture goes to the next pass that asks for the same kind, so targets whose lifetimes
+// don't overlap within a frame share memory (e.g. the bright color of the scene and the first blur buffer).
+// Textures nobody asked for during maxUnusedFrames frames are deleted. Framebuffers are cached per
+// combination of attachments.
+class RenderTargetPool
+{
+public:
+    // frames a free texture is kept for a later request
+    unsigned int maxUnusedFrames = 30;
+    // bytes of all textures of the pool
+    size_t allocatedBytes = 0;
+    // the most bytes in use at once during the last frame
+    size_t lastFrameBytes = 0;
+    // textures created during the last frame, after the first frames this should stay 0
+    unsigned int lastFrameAllocations = 0;
+
+    ~RenderTargetPool() {
+        for (unsigned int i = 0; i < framebuffers.size(); i++)
+            glState().deleteFramebuffer(framebuffers[i].id);
+        for (unsigned int i = 0; i < targets.size(); i++)
+            glState().deleteTexture(targets[i].texture);
+    }
+
+    // a texture of the given kind that no one else uses until it is released
+    GLuint acquire(GLenum internalFormat, unsigned int width, unsigned int height, GLenum filter = GL_LINEAR) {
+        for (unsigned int i = 0; i < targets.size(); i++) {
+            Target& target = targets[i];
+            if (!target.inUse && target.internalFormat == internalFormat && target.width == width && target.height == height && target.filter == filter) {
+                use(target);
+                return target.texture;
+            }
+        }
+        Target target;
+        target.internalFormat = internalFormat;
+        target.width = width;
+        target.height = height;
+        target.filter = filter;
+        glGenTextures(1, &target.texture);
+        glState().bindTexture(GL_TEXTURE_2D, target.texture);
+        GLenum format = GL_RGBA, type = GL_FLOAT;
+        uploadFormat(internalFormat, format, type);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        allocatedBytes += target.bytes();
+        allocations++;
+        targets.push_back(target);
+        use(targets.back());
+        return target.texture;
+    }
+
+    // hands a texture back, its content may be overwritten by the next pass that acquires one
+    void release(GLuint texture) {
+        Target* target = find(texture);
+        if (target == nullptr || !target->inUse) {
+            cout << "ERROR::RENDER_TARGET_POOL:: released texture " << texture << " is not in use" << endl;
+            return;
+        }
+        target->inUse = false;
+        usedBytes -= target->bytes();
+    }
+
+    // a framebuffer with the textures attached, colors in the order of their attachment points. All color
+    // attachments are draw buffers.
+    GLuint framebuffer(const vector<GLuint>& colors, GLuint depth = 0) {
+        for (unsigned int i = 0; i < framebuffers.size(); i++) {
+            if (framebuffers[i].colors == colors && framebuffers[i].depth == depth)
+                return framebuffers[i].id;
+        }
+        Framebuffer framebuffer;
+        framebuffer.colors = colors;
+        framebuffer.depth = depth;
+        glGenFramebuffers(1, &framebuffer.id);
+        glState().bindFramebuffer(framebuffer.id);
+        vector<GLenum> drawBuffers;
+        for (unsigned int i = 0; i < colors.size(); i++) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colors[i], 0);
+            drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+        }
+        if (depth != 0) {
+            Target* target = find(depth);
+            GLenum attachment = target != nullptr && target->internalFormat == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, depth, 0);
+        }
+        if (drawBuffers.empty())
+            glDrawBuffer(GL_NONE);
+        else
+            glDrawBuffers((GLsizei)drawBuffers.size(), &drawBuffers[0]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::RENDER_TARGET_POOL:: framebuffer is not complete" << endl;
+        framebuffers.push_back(framebuffer);
+        return framebuffer.id;
+    }
+
+    // ends the frame: deletes the textures unused for too long, with the framebuffers they are attached to
+    void endFrame() {
+        frame++;
+        lastFrameBytes = peakBytes;
+        peakBytes = usedBytes;
+        lastFrameAllocations = allocations;
+        allocations = 0;
+        for (unsigned int i = 0; i < targets.size();) {
+            Target& target = targets[i];
+            if (target.inUse || frame - target.lastUsedFrame <= maxUnusedFrames) {
+                i++;
+                continue;
+            }
+            for (unsigned int j = 0; j < framebuffers.size();) {
+                Framebuffer& framebuffer = framebuffers[j];
+                if (framebuffer.depth == target.texture || std::find(framebuffer.colors.begin(), framebuffer.colors.end(), target.texture) != framebuffer.colors.end()) {
+                    glState().deleteFramebuffer(framebuffer.id);
+                    framebuffers.erase(framebuffers.begin() + j);
+                }
+                else {
+                    j++;
+                }
+            }
+            allocatedBytes -= target.bytes();
+            glState().deleteTexture(target.texture);
+            targets.erase(targets.begin() + i);
+        }
+    }
+
+private:
+    struct Target {
+        GLuint texture = 0;
+        GLenum internalFormat = 0;
+        unsigned int width = 0, height = 0;
+        GLenum filter = GL_LINEAR;
+        bool inUse = false;
+        unsigned int lastUsedFrame = 0;
+
+        size_t bytes() const {
+            return (size_t)width * height * bytesPerTexel(internalFormat);
+        }
+    };
+    struct Framebuffer {
+        GLuint id = 0;
+        vector<GLuint> colors;
+        GLuint depth = 0;
+    };
+    vector<Target> targets;
+    vector<Framebuffer> framebuffers;
+    unsigned int frame = 0;
+    size_t usedBytes = 0;
+    size_t peakBytes = 0;
+    unsigned int allocations = 0;
+
+    void use(Target& target) {
+        target.inUse = true;
+        target.lastUsedFrame = frame;
+        usedBytes += target.bytes();
+        peakBytes = std::max(peakBytes, usedBytes);
+    }
+
+    Target* find(GLuint texture) {
+        for (unsigned int i = 0; i < targets.size(); i++) {
+            if (targets[i].texture == texture)
+                return &targets[i];
+        }
+        return nullptr;
+    }
+
+    static unsigned int bytesPerTexel(GLenum internalFormat) {
+        switch (internalFormat) {
+        case GL_RGBA32F: return 16;
+        case GL_RGBA16F: return 8;
+        case GL_RGB16F: return 6;
+        case GL_RG32F: return 8;
+        case GL_RG16F: return 4;
+        case GL_R32F: return 4;
+        case GL_R16F: return 2;
+        case GL_R8: return 1;
+        default: return 4; // GL_RGBA8, GL_SRGB8_ALPHA8, GL_DEPTH24_STENCIL8, GL_DEPTH_COMPONENT24 (padded) and GL_DEPTH_COMPONENT32F
+        }
+    }
+
+    // the format and type of the (empty) data of an internal format
+    static void uploadFormat(GLenum internalFormat, GLenum& format, GLenum& type) {
+        switch (internalFormat) {
+        case GL_DEPTH24_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; break;
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32F: format = GL_DEPTH_COMPONENT; type = GL_FLOAT; break;
+        case GL_RG16F:
+        case GL_RG32F: format = GL_RG; type = GL_FLOAT; break;
+        case GL_R16F:
+        case GL_R32F: format = GL_RED; type = GL_FLOAT; break;
+        case GL_R8: format = GL_RED; type = GL_UNSIGNED_BYTE; break;
+        case GL_RGBA8:
+        case GL_SRGB8_ALPHA8: format = GL_RGBA; type = GL_UNSIGNED_BYTE; break;
+        case GL_RGB16F: format = GL_RGB; type = GL_FLOAT; break;
+        default: format = GL_RGBA; type = GL_FLOAT; break;
+        }
+    }
+};
+#endif
@@ -0,0 +1,75 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// Transform hierarchy of a model. The nodes are stored as flat arrays (structure of arrays) in topological
+// order, a parent always comes before its children, so the world transforms are updated in a single linear
+// pass. Only nodes whose local transform changed, and their subtrees, are recomputed.
+class SceneGraph
+{
+public:
+    static const int NO_PARENT = -1;
+
+    vector<int> parents;
+    vector<string> names;
+    vector<glm::mat4> localTransforms;
+    // world transforms relative to the model, read by the renderer
+    vector<glm::mat4> worldTransforms;
+    // number of world transforms recomputed by the last update
+    unsigned int updatedNodes = 0;
+
+    // appends a node, the parent has to be added before its children
+    unsigned int addNode(int parent, const glm::mat4& localTransform, const string& name) {
+        parents.push_back(parent);
+        names.push_back(name);
+        localTransforms.push_back(localTransform);
+        worldTransforms.push_back(localTransform);
+        dirty.push_back(1);
+        return static_cast<unsigned int>(parents.size() - 1);
+    }
+
+    unsigned int size() const {
+        return static_cast<unsigned int>(parents.size());
+    }
+
+    // returns the index of the first node with the given name or NO_PARENT if there is none
+    int find(const string& name) const {
+        for (unsigned int i = 0; i < names.size(); i++) {
+            if (names[i] == name)
+                return static_cast<int>(i);
+        }
+        return NO_PARENT;
+    }
+
+    void setLocalTransform(unsigned int node, const glm::mat4& localTransform) {
+        localTransforms[node] = localTransform;
+        dirty[node] = 1;
+    }
+
+    // recomputes the world transforms of the changed subtrees
+    void update() {
+        updatedNodes = 0;
+        for (unsigned int i = 0; i < parents.size(); i++) {
+            int parent = parents[i];
+            // the parent was visited before, so its flag already tells if it changed in this update
+            if (parent != NO_PARENT && dirty[parent])
+                dirty[i] = 1;
+            if (!dirty[i])
+                continue;
+            worldTransforms[i] = parent == NO_PARENT ? localTransforms[i] : worldTransforms[parent] * localTransforms[i];
+            updatedNodes++;
+        }
+        // clear the flags only after the pass, the children read them
+        for (unsigned int i = 0; i < dirty.size(); i++)
+            dirty[i] = 0;
+    }
+
+private:
+    vector<unsigned char> dirty;
+};
+#endif
@@ -3,54 +3,100 @@
 
 #include <glad/glad.h>
 
+#include "gl_state.h"
+#include "gl_extensions.h"
+#include "startup_trace.h"
+
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
 using namespace std;
 
 class Shader {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly. The fragment shader may be left out ("") for programs that
+    // only capture a vertex output with transform feedback, feedbackVarying is the name of that output.
+    // defines are inserted as "#define NAME" after the #version line of every stage, and the sources may
+    // #include "file" other files (relative to the including file, every file is included once).
+    // The constructor only submits the compile and link, the results are checked when the program is first used.
+    // Programs created one after another therefore compile in parallel on drivers with
+    // GL_KHR_parallel_shader_compile, and the driver's work overlaps with whatever the application does until then.
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* geometryPath, const char* fragmentPath) {
-        ID = glCreateProgram();
-        // vertex shader
-        unsigned int vertexShader = createShader(vertexPath, "VERTEX");
-        glAttachShader(ID, vertexShader);
-        // fragment shader
-        unsigned int fragmentShader = createShader(fragmentPath, "FRAGMENT");
-        glAttachShader(ID, fragmentShader);
-        // geometry shader
-        unsigned int geometryShader = 0;
-        if (geometryPath[0] != '\0') {
-            geometryShader = createShader(geometryPath, "GEOMETRY");
-            glAttachShader(ID, geometryShader);
-        }
-        // link shaders
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
-        if (geometryPath[0] != '\0') {
-            glDeleteShader(geometryShader);
+    Shader(const char* vertexPath, const char* geometryPath, const char* fragmentPath, const char* feedbackVarying = nullptr,
+        const vector<string>& defines = vector<string>()) :
+        vertexPath(vertexPath), geometryPath(geometryPath), fragmentPath(fragmentPath),
+        feedbackVarying(feedbackVarying != nullptr ? feedbackVarying : ""), defines(defines) {
+        build();
+    }
+    // compiles the sources again (for hot reloading). If the new program links it replaces the old one and gets
+    // the uniform block bindings and int uniforms (sampler units) that were set on the old one, otherwise the old
+    // program is kept and false is returned. Waits for the compilation. Float, vector and matrix uniforms are not
+    // carried over, a watched shader has to set them before every use.
+    // ------------------------------------------------------------------------
+    bool reload() {
+        bool previousLinked = checkLink();
+        unsigned int previous = ID;
+        build();
+        if (!checkLink()) {
+            glDeleteProgram(ID);
+            ID = previous;
+            linked = previousLinked;
+            return false;
         }
+        glDeleteProgram(previous);
+        for (unsigned int i = 0; i < blockBindings.size(); i++)
+            setUniformBlockBinding(blockBindings[i].first, blockBindings[i].second);
+        use();
+        for (auto it = intUniforms.begin(); it != intUniforms.end(); ++it)
+            glUniform1i(glGetUniformLocation(ID, it->first.c_str()), it->second);
+        return true;
+    }
+    // all files the program was built from, including the included ones
+    // ------------------------------------------------------------------------
+    const vector<string>& files() const {
+        return sourceFiles;
+    }
+    // true if the program has finished compiling and linking, so using it won't block. Without
+    // GL_KHR_parallel_shader_compile there is no way to ask, the program is reported ready.
+    // ------------------------------------------------------------------------
+    bool isReady() const {
+        if (linkChecked || !glExtensions().parallelShaderCompile)
+            return true;
+        GLint completed = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed == GL_TRUE;
     }
     // activate the shader before any calls to glUniform
     // (finding the uniform location does not require you to use the shader program first, but updating a uniform does require you to first use the program (by calling glUseProgram), because it sets the uniform on the currently active shader program.)
     // ------------------------------------------------------------------------
     void use() {
-        glUseProgram(ID);
+        checkLink();
+        glState().useProgram(ID);
+    }
+    // links the uniform block with the given name to a binding point (does nothing if the shader doesn't use the block)
+    // ------------------------------------------------------------------------
+    void setUniformBlockBinding(const string& name, unsigned int binding) const {
+        checkLink();
+        rememberBlockBinding(name, binding);
+        unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBoolUniform(const string& name, bool value) const {
+        intUniforms[name] = (int)value;
         glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
     }
     // ------------------------------------------------------------------------
     void setIntUniform(const string& name, int value) const {
+        intUniforms[name] = value;
         glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
     }
     // ------------------------------------------------------------------------
@@ -63,6 +109,10 @@ public:
         // glUniformMatrix4fv(glGetUniformLocation(shaderProgram, name.c_str()), 1, GL_FALSE, &value[0][0]);
     }
     // ------------------------------------------------------------------------
+    void setVec2Uniform(const string& name, glm::vec2 value) const {
+        glUniform2f(glGetUniformLocation(ID, name.c_str()), value.x, value.y);
+    }
+    // ------------------------------------------------------------------------
     void setVec3Uniform(const string& name, float value1, float value2, float value3) const {
         glUniform3f(glGetUniformLocation(ID, name.c_str()), value1, value2, value3);
     }
@@ -82,9 +132,75 @@ public:
     }
 
 private:
+    // a compiled stage, kept until the link has been checked so its errors can still be reported
+    struct Stage {
+        unsigned int shader;
+        string type;
+        // the #line directives refer to the files by their index
+        vector<string> sourceFiles;
+    };
+    string vertexPath, geometryPath, fragmentPath, feedbackVarying;
+    vector<string> defines;
+    vector<string> sourceFiles;
+    mutable vector<Stage> stages;
+    mutable bool linkChecked = false;
+    mutable bool linked = false;
+    // program state that has to be restored when the program is rebuilt
+    mutable vector<pair<string, unsigned int> > blockBindings;
+    mutable map<string, int> intUniforms;
+
+    // creates the program and submits the compilation of its stages and the link
+    void build() {
+        ID = glCreateProgram();
+        linkChecked = false;
+        sourceFiles.clear();
+        // vertex shader
+        createShader(vertexPath.c_str(), "VERTEX");
+        // fragment shader
+        if (!fragmentPath.empty())
+            createShader(fragmentPath.c_str(), "FRAGMENT");
+        // geometry shader
+        if (!geometryPath.empty())
+            createShader(geometryPath.c_str(), "GEOMETRY");
+        // transform feedback outputs have to be declared before linking
+        if (!feedbackVarying.empty()) {
+            const char* varying = feedbackVarying.c_str();
+            glTransformFeedbackVaryings(ID, 1, &varying, GL_INTERLEAVED_ATTRIBS);
+        }
+        // link shaders
+        glLinkProgram(ID);
+    }
+
+    // reports the compile and link errors on the first use, waiting for the driver if it isn't done yet.
+    // Returns whether the program linked.
+    bool checkLink() const {
+        if (linkChecked)
+            return linked;
+        linkChecked = true;
+        TraceScope trace("wait for link of " + (fragmentPath.empty() ? vertexPath : fragmentPath));
+        for (unsigned int i = 0; i < stages.size(); i++)
+            checkCompileErrors(stages[i].shader, stages[i].type, stages[i].sourceFiles);
+        linked = checkCompileErrors(ID, "PROGRAM", vector<string>());
+        // delete the shaders as they're linked into our program now and no longer necessary
+        for (unsigned int i = 0; i < stages.size(); i++)
+            glDeleteShader(stages[i].shader);
+        stages.clear();
+        return linked;
+    }
+
+    void rememberBlockBinding(const string& name, unsigned int binding) const {
+        for (unsigned int i = 0; i < blockBindings.size(); i++) {
+            if (blockBindings[i].first == name) {
+                blockBindings[i].second = binding;
+                return;
+            }
+        }
+        blockBindings.push_back(make_pair(name, binding));
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(unsigned int shader, string type) {
+    static bool checkCompileErrors(unsigned int shader, const string& type, const vector<string>& sourceFiles) {
         int success;
         char infoLog[1024];
         if (type != "PROGRAM")
@@ -93,7 +209,10 @@ private:
             if (!success)
             {
                 glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-                cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << endl;
+                cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n";
+                for (unsigned int i = 0; i < sourceFiles.size(); i++)
+                    cout << "  source " << i << ": " << sourceFiles[i] << "\n";
+                cout << infoLog << "\n -- --------------------------------------------------- -- " << endl;
             }
         }
         else
@@ -105,28 +224,81 @@ private:
                 cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << endl;
             }
         }
+        return success != 0;
     }
 
-    int createShader(const char* path, string type) {
-        // 1. retrieve the vertex/fragment source code from filePath
-        string shaderString;
+    // reads a source file, false if it can't be read
+    static bool readFile(const string& path, string& contents) {
         ifstream shaderFile;
         // ensure ifstream objects can throw exceptions:
         shaderFile.exceptions(ifstream::failbit | ifstream::badbit);
         try {
             // open files
-            shaderFile.open(path);
+            shaderFile.open(path.c_str());
             stringstream shaderStream;
             // read file's buffer contents into streams
             shaderStream << shaderFile.rdbuf();
             // close file handlers
             shaderFile.close();
             // convert stream into string
-            shaderString = shaderStream.str();
+            contents = shaderStream.str();
         }
         catch (ifstream::failure& e) {
-            cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+            cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << " " << e.what() << std::endl;
+            return false;
         }
+        return true;
+    }
+
+    // the source of a file with its includes expanded. #line directives keep the line numbers of compile errors
+    // pointing into the right file (the second number is the index into sourceFiles).
+    string preprocess(const string& path, vector<string>& sourceFiles) {
+        for (unsigned int i = 0; i < sourceFiles.size(); i++) {
+            if (sourceFiles[i] == path)
+                return "";
+        }
+        string contents;
+        if (!readFile(path, contents))
+            return "";
+        unsigned int fileIndex = static_cast<unsigned int>(sourceFiles.size());
+        sourceFiles.push_back(path);
+        string directory = path.find_last_of("/\\") == string::npos ? "" : path.substr(0, path.find_last_of("/\\") + 1);
+
+        string result;
+        istringstream lines(contents);
+        string line;
+        unsigned int lineNumber = 0;
+        while (getline(lines, line)) {
+            lineNumber++;
+            size_t start = line.find_first_not_of(" \t");
+            if (start != string::npos && line.compare(start, 8, "#include") == 0) {
+                size_t open = line.find('"', start), close = line.find('"', open + 1);
+                if (open == string::npos || close == string::npos) {
+                    cout << "ERROR::SHADER::MALFORMED_INCLUDE: " << path << "(" << lineNumber << ")" << endl;
+                    continue;
+                }
+                result += "#line 1 " + to_string(sourceFiles.size()) + "\n";
+                result += preprocess(directory + line.substr(open + 1, close - open - 1), sourceFiles);
+                result += "#line " + to_string(lineNumber + 1) + " " + to_string(fileIndex) + "\n";
+                continue;
+            }
+            result += line + "\n";
+            // the defines have to follow the #version line
+            if (start != string::npos && line.compare(start, 8, "#version") == 0 && !defines.empty()) {
+                for (unsigned int i = 0; i < defines.size(); i++)
+                    result += "#define " + defines[i] + "\n";
+                result += "#line " + to_string(lineNumber + 1) + " " + to_string(fileIndex) + "\n";
+            }
+        }
+        return result;
+    }
+
+    // compiles a stage and attaches it to the program
+    void createShader(const char* path, string type) {
+        // 1. retrieve the source code from filePath, with the defines and includes
+        Stage stage;
+        stage.type = type;
+        string shaderString = preprocess(path, stage.sourceFiles);
         const char* shaderCode = shaderString.c_str();
 
         // 2. build and compile our shader program
@@ -143,9 +315,13 @@ private:
         }
         glShaderSource(shader, 1, &shaderCode, NULL);
         glCompileShader(shader);
-        checkCompileErrors(shader, type);
-
-        return shader;
+        glAttachShader(ID, shader);
+        stage.shader = shader;
+        stages.push_back(stage);
+        for (unsigned int i = 0; i < stage.sourceFiles.size(); i++) {
+            if (std::find(sourceFiles.begin(), sourceFiles.end(), stage.sourceFiles[i]) == sourceFiles.end())
+                sourceFiles.push_back(stage.sourceFiles[i]);
+        }
     }
 };
 #endif
\ No newline at end of file
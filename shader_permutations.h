@@ -0,0 +1,131 @@
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include "shader.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Features that are compiled into a shader variant instead of being branched on at runtime. Every feature
+// is a HAS_<NAME> define in the source, the draw calls ask for the combination they need.
+enum ShaderFeature {
+    SHADER_SHADOWS = 1 << 0,  // point light shadows from the depth cubemap
+    SHADER_PARALLAX = 1 << 1, // parallax occlusion mapping with the height in the orm texture
+    SHADER_EMISSIVE = 1 << 2, // the material has an emissive map
+    SHADER_OPACITY = 1 << 3,  // the material has an opacity map
+    SHADER_FEATURE_COUNT = 4
+};
+
+inline const char* shaderFeatureDefine(unsigned int index) {
+    static const char* defines[SHADER_FEATURE_COUNT] = { "HAS_SHADOWS", "HAS_PARALLAX", "HAS_EMISSIVE", "HAS_OPACITY" };
+    return defines[index];
+}
+
+// The variants of one shader program, compiled the first time a combination of features is requested.
+// Features the source doesn't know (not in supportedFeatures) are ignored, so the shadow pass and the main
+// pass can be asked for the same combination. Variants that are known to be needed can be submitted early with
+// prepare, they then compile while the application loads (see Shader). A variant requested at runtime (e.g. after
+// a feature was toggled) compiles in the background while the closest ready variant is drawn instead.
+class ShaderPermutations
+{
+public:
+    // called for every variant when it is first returned by get, once it is ready, e.g. to bind the uniform blocks
+    // and the fixed sampler units
+    function<void(Shader&)> setup;
+
+    // featureDefines names the define of every feature bit, by default the ones of ShaderFeature
+    ShaderPermutations(const char* vertexPath, const char* geometryPath, const char* fragmentPath, unsigned int supportedFeatures,
+        const vector<string>& featureDefines = vector<string>()) :
+        vertexPath(vertexPath), geometryPath(geometryPath), fragmentPath(fragmentPath), supportedFeatures(supportedFeatures), featureDefines(featureDefines) {
+        if (this->featureDefines.empty()) {
+            for (unsigned int i = 0; i < SHADER_FEATURE_COUNT; i++)
+                this->featureDefines.push_back(shaderFeatureDefine(i));
+        }
+    }
+
+    // submits the compilation of a variant without waiting for it
+    void prepare(unsigned int features) {
+        features &= supportedFeatures;
+        if (variants.find(features) != variants.end())
+            return;
+        vector<string> defines;
+        for (unsigned int i = 0; i < featureDefines.size(); i++) {
+            if (features & (1u << i))
+                defines.push_back(featureDefines[i]);
+        }
+        Variant& variant = variants[features];
+        variant.shader.reset(new Shader(vertexPath.c_str(), geometryPath.c_str(), fragmentPath.c_str(), nullptr, defines));
+    }
+
+    // the shader to draw with for a combination of features, on the GL thread. Until its variant finished compiling
+    // (see Shader::isReady) the ready variant with the fewest different features stands in for it, so the frame
+    // doesn't wait for the compiler. Only while no variant is ready at all the variant itself is returned.
+    Shader& get(unsigned int features) {
+        features &= supportedFeatures;
+        auto it = variants.find(features);
+        if (it == variants.end()) {
+            prepare(features);
+            it = variants.find(features);
+        }
+        Variant& variant = it->second;
+        if (!variant.configured && (variant.shader->isReady() || closestReady(features) == nullptr)) {
+            variant.configured = true;
+            if (setup)
+                setup(*variant.shader);
+        }
+        variant.drawn = variant.configured ? variant.shader.get() : closestReady(features);
+        return *variant.drawn;
+    }
+
+    // the shader the last get returned for the features, may be called from other threads while get isn't
+    Shader& lookup(unsigned int features) const {
+        return *variants.find(features & supportedFeatures)->second.drawn;
+    }
+
+    // appends the variants compiled so far
+    void collect(vector<Shader*>& shaders) const {
+        for (auto it = variants.begin(); it != variants.end(); ++it)
+            shaders.push_back(it->second.shader.get());
+    }
+
+    // number of variants compiled so far
+    unsigned int variantCount() const {
+        return static_cast<unsigned int>(variants.size());
+    }
+
+private:
+    string vertexPath, geometryPath, fragmentPath;
+    unsigned int supportedFeatures;
+    vector<string> featureDefines;
+    struct Variant {
+        unique_ptr<Shader> shader;
+        // ready and set up
+        bool configured = false;
+        // what get returned last, this variant or the one standing in for it
+        Shader* drawn = nullptr;
+    };
+    map<unsigned int, Variant> variants;
+
+    // the ready variant whose features differ in the fewest bits, nullptr if none is ready
+    Shader* closestReady(unsigned int features) const {
+        Shader* closest = nullptr;
+        unsigned int closestDifference = ~0u;
+        for (auto it = variants.begin(); it != variants.end(); ++it) {
+            if (!it->second.configured)
+                continue;
+            unsigned int difference = 0;
+            for (unsigned int bits = it->first ^ features; bits != 0; bits &= bits - 1)
+                difference++;
+            if (difference < closestDifference) {
+                closest = it->second.shader.get();
+                closestDifference = difference;
+            }
+        }
+        return closest;
+    }
+};
+#endif
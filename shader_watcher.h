@@ -0,0 +1,163 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include "shader.h"
+#include "shader_permutations.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Hot reloading of shaders. A background thread polls the modification times and sizes of all source files of
+// the watched programs (the included files too), update() on the GL thread rebuilds the programs that use a
+// changed file. The modification times only have a resolution of a second, so the contents of files modified
+// in the last second are compared as well, otherwise two saves within a second would be missed. A program that
+// fails to compile keeps running with its previous version (see Shader::reload).
+class ShaderWatcher
+{
+public:
+    // how often the files are checked
+    unsigned int pollMilliseconds = 250;
+
+    ShaderWatcher() : poller([this]() { poll(); }) {}
+
+    ~ShaderWatcher() {
+        {
+            lock_guard<mutex> lock(fileMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        poller.join();
+    }
+
+    void watch(Shader& shader) {
+        shaders.push_back(&shader);
+    }
+
+    // watches all variants, also the ones compiled later
+    void watch(ShaderPermutations& permutations) {
+        permutationSets.push_back(&permutations);
+    }
+
+    // reloads the programs that use a file changed since the last call, returns the number of replaced programs
+    unsigned int update() {
+        vector<Shader*> programs = shaders;
+        for (unsigned int i = 0; i < permutationSets.size(); i++)
+            permutationSets[i]->collect(programs);
+
+        vector<string> changed;
+        {
+            lock_guard<mutex> lock(fileMutex);
+            // the files can change with every reload (new includes), so the list is refreshed every time
+            watchedFiles.clear();
+            for (unsigned int i = 0; i < programs.size(); i++) {
+                const vector<string>& files = programs[i]->files();
+                for (unsigned int j = 0; j < files.size(); j++) {
+                    if (std::find(watchedFiles.begin(), watchedFiles.end(), files[j]) == watchedFiles.end())
+                        watchedFiles.push_back(files[j]);
+                }
+            }
+            changed.swap(changedFiles);
+        }
+        if (changed.empty())
+            return 0;
+
+        unsigned int reloaded = 0;
+        for (unsigned int i = 0; i < programs.size(); i++) {
+            const vector<string>& files = programs[i]->files();
+            bool affected = false;
+            for (unsigned int j = 0; j < changed.size() && !affected; j++)
+                affected = std::find(files.begin(), files.end(), changed[j]) != files.end();
+            if (!affected)
+                continue;
+            string name = files.empty() ? "" : files[0];
+            if (programs[i]->reload()) {
+                reloaded++;
+                cout << "SHADER_WATCHER:: reloaded " << name << endl;
+            }
+            else {
+                cout << "ERROR::SHADER_WATCHER:: " << name << " failed to build, the previous program is kept" << endl;
+            }
+        }
+        return reloaded;
+    }
+
+private:
+    vector<Shader*> shaders;
+    vector<ShaderPermutations*> permutationSets;
+
+    // shared with the polling thread
+    mutex fileMutex;
+    condition_variable wake;
+    bool stopping = false;
+    vector<string> watchedFiles;
+    vector<string> changedFiles;
+    thread poller;
+
+    struct FileState {
+        time_t modificationTime = 0;
+        long long size = 0;
+        // hash of the contents, only read while the file was modified recently
+        bool hashed = false;
+        size_t contentHash = 0;
+
+        bool differs(const FileState& other) const {
+            return modificationTime != other.modificationTime || size != other.size
+                || (hashed && other.hashed && contentHash != other.contentHash);
+        }
+    };
+
+    static size_t hashContents(const string& path) {
+        ifstream file(path.c_str(), ios::binary);
+        stringstream contents;
+        contents << file.rdbuf();
+        return std::hash<string>()(contents.str());
+    }
+
+    void poll() {
+        // last seen state of every file, only used by this thread
+        map<string, FileState> fileStates;
+        unique_lock<mutex> lock(fileMutex);
+        while (!stopping) {
+            vector<string> files = watchedFiles;
+            lock.unlock();
+            vector<string> changed;
+            for (unsigned int i = 0; i < files.size(); i++) {
+                struct stat info;
+                if (stat(files[i].c_str(), &info) != 0)
+                    continue;
+                FileState state;
+                state.modificationTime = info.st_mtime;
+                state.size = info.st_size;
+                if (time(nullptr) - info.st_mtime <= 1) {
+                    state.hashed = true;
+                    state.contentHash = hashContents(files[i]);
+                }
+                auto known = fileStates.find(files[i]);
+                if (known != fileStates.end() && known->second.differs(state))
+                    changed.push_back(files[i]);
+                fileStates[files[i]] = state;
+            }
+            lock.lock();
+            for (unsigned int i = 0; i < changed.size(); i++) {
+                if (std::find(changedFiles.begin(), changedFiles.end(), changed[i]) == changedFiles.end())
+                    changedFiles.push_back(changed[i]);
+            }
+            wake.wait_for(lock, chrono::milliseconds(pollMilliseconds), [this]() { return stopping; });
+        }
+    }
+};
+#endif
@@ -1,15 +1,14 @@
 #version 330 core
 in vec4 FragPos;
 
-uniform vec3 lightPos;
-uniform float far_plane;
+#include "frame_data.glsl"
 
 void main()
 {
-    float lightDistance = length(FragPos.xyz - lightPos);
+    float lightDistance = length(FragPos.xyz - lightPos.xyz);
     
     // map to [0;1] range by dividing by far_plane
-    lightDistance = lightDistance / far_plane;
+    lightDistance = lightDistance / params.x;
     
     // write this as modified depth
     gl_FragDepth = lightDistance;
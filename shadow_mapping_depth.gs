@@ -2,7 +2,7 @@
 layout (triangles) in;
 layout (triangle_strip, max_vertices=18) out;
 
-uniform mat4 shadowMatrices[6];
+#include "frame_data.glsl"
 
 out vec4 FragPos; // FragPos from GS (output per emitvertex)
 
@@ -10,6 +10,8 @@ void main()
 {
     for(int face = 0; face < 6; ++face)
     {
+        if ((flags.x & (1 << face)) == 0) // the object is outside of this face's frustum
+            continue;
         gl_Layer = face; // built-in variable that specifies to which face we render.
         for(int i = 0; i < 3; ++i) // for each triangle's vertices
         {
@@ -1,7 +1,7 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 model;
+#include "frame_data.glsl"
 
 void main() {
     gl_Position = model * vec4(aPos, 1.0);
@@ -1,11 +1,17 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 2) out vec2 Velocity;
 
 in vec3 TexCoords;
+in vec4 CurrentClipPos;
+in vec4 PreviousClipPos;
 
 uniform samplerCube environmentMap;
 
+#include "velocity.glsl"
+
 void main() {    
     FragColor = textureLod(environmentMap, TexCoords, 0);
+    Velocity = ScreenVelocity(CurrentClipPos, PreviousClipPos);
     //FragColor = vec4(1.0);
 }
\ No newline at end of file
@@ -2,13 +2,17 @@
 layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
+out vec4 CurrentClipPos;
+out vec4 PreviousClipPos;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "frame_data.glsl"
 
 void main()
 {
     TexCoords = aPos;
-    vec4 pos = projection * view * vec4(aPos, 1.0);
+    vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0); // remove translation from the view matrix
 	gl_Position = pos.xyww;
+    // the sky is infinitely far away, only the rotation of the camera moves it (w = 0 drops the translation)
+    CurrentClipPos = pos - vec4(jitter.xy * pos.w, 0.0, 0.0);
+    PreviousClipPos = previousViewProjection * vec4(aPos, 0.0);
 }  
\ No newline at end of file
@@ -0,0 +1,279 @@
+#ifndef STARTUP_TRACE_H
+#define STARTUP_TRACE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Where the time until the first frame goes: the phases of the startup are timed with nested scopes (see
+// TraceScope) on the GL thread and on the jobs. Scopes of the GL thread also measure the GPU with timestamp
+// queries once the context exists; the results are read when they are available, a few frames after the first
+// one, so nothing waits for the GPU. The first report prints the scopes of the GL thread as a tree and the jobs
+// summed by name, and can write them as a Chrome trace (chrome://tracing, Perfetto) with a track per thread
+// and one for the GPU. Scopes started after the first frame are not recorded.
+class StartupTrace
+{
+public:
+    static const unsigned int NO_EVENT = ~0u;
+
+    StartupTrace() : origin(chrono::steady_clock::now()), glThread(this_thread::get_id()) {}
+
+    // starts measuring the GPU in the scopes of the GL thread, needs the GL context
+    void startGpuTiming() {
+        GLint64 timestamp = 0;
+        glGetInteger64v(GL_TIMESTAMP, &timestamp);
+        gpuOrigin = timestamp;
+        gpuOriginMicroseconds = now();
+        gpuTiming = true;
+    }
+
+    // starts a scope of the calling thread, scopes of a thread end in the reverse order
+    unsigned int begin(const string& name) {
+        if (!recording)
+            return NO_EVENT;
+        Event event;
+        event.name = name;
+        event.depth = depth()++;
+        event.start = now();
+        bool onGlThread = this_thread::get_id() == glThread;
+        if (onGlThread && gpuTiming) {
+            glGenQueries(2, event.queries);
+            glQueryCounter(event.queries[0], GL_TIMESTAMP);
+        }
+        lock_guard<mutex> lock(eventMutex);
+        event.thread = threadIndex();
+        events.push_back(event);
+        return (unsigned int)events.size() - 1;
+    }
+
+    void end(unsigned int index) {
+        if (index == NO_EVENT)
+            return;
+        double end = now();
+        depth()--;
+        lock_guard<mutex> lock(eventMutex);
+        Event& event = events[index];
+        event.end = end;
+        if (event.queries[1] != 0)
+            glQueryCounter(event.queries[1], GL_TIMESTAMP);
+    }
+
+    // called after every frame: the first call stops recording, the report follows once the GPU times arrived.
+    // The trace is written to tracePath unless it is empty. Returns true once reported.
+    bool report(ostream& out, const string& tracePath) {
+        if (reported)
+            return true;
+        if (recording) {
+            recording = false;
+            firstFrame = now();
+        }
+        lock_guard<mutex> lock(eventMutex);
+        for (unsigned int i = 0; i < events.size(); i++) {
+            if (events[i].queries[1] == 0)
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(events[i].queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return false;
+        }
+        for (unsigned int i = 0; i < events.size(); i++) {
+            Event& event = events[i];
+            if (event.queries[1] == 0)
+                continue;
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(event.queries[0], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(event.queries[1], GL_QUERY_RESULT, &end);
+            event.gpuStart = gpuOriginMicroseconds + ((GLint64)start - gpuOrigin) / 1000.0;
+            event.gpuEnd = gpuOriginMicroseconds + ((GLint64)end - gpuOrigin) / 1000.0;
+            glDeleteQueries(2, event.queries);
+        }
+        reported = true;
+        print(out);
+        if (!tracePath.empty())
+            writeTrace(tracePath);
+        return true;
+    }
+
+private:
+    struct Event {
+        string name;
+        unsigned int thread = 0;
+        unsigned int depth = 0;
+        // microseconds since the start of the application, the end is negative while the scope runs
+        double start = 0.0, end = -1.0;
+        double gpuStart = 0.0, gpuEnd = 0.0;
+        // timestamps at the start and the end of the scope, 0 if the GPU isn't measured
+        GLuint queries[2] = { 0, 0 };
+    };
+
+    chrono::steady_clock::time_point origin;
+    thread::id glThread;
+    // the GPU clock at gpuOriginMicroseconds, to place the GPU times on the timeline of the CPU
+    GLint64 gpuOrigin = 0;
+    double gpuOriginMicroseconds = 0.0;
+    bool gpuTiming = false;
+    // read by the jobs, cleared by the GL thread
+    atomic<bool> recording{ true };
+    bool reported = false;
+    double firstFrame = 0.0;
+    mutex eventMutex;
+    vector<Event> events;
+    // the threads in the order of their first scope, the GL thread is always 0
+    vector<thread::id> threads;
+
+    double now() const {
+        return chrono::duration<double, micro>(chrono::steady_clock::now() - origin).count();
+    }
+
+    static unsigned int& depth() {
+        static thread_local unsigned int value = 0;
+        return value;
+    }
+
+    // called with the events locked
+    unsigned int threadIndex() {
+        if (threads.empty())
+            threads.push_back(glThread);
+        thread::id id = this_thread::get_id();
+        for (unsigned int i = 0; i < threads.size(); i++) {
+            if (threads[i] == id)
+                return i;
+        }
+        threads.push_back(id);
+        return (unsigned int)threads.size() - 1;
+    }
+
+    void print(ostream& out) const {
+        ios::fmtflags flags = out.flags();
+        streamsize precision = out.precision();
+        out << fixed << setprecision(1);
+        out << "STARTUP:: first frame after " << firstFrame / 1000.0 << " ms" << endl;
+        out << "STARTUP:: " << left << setw(44) << "GL thread" << right << setw(10) << "cpu ms" << setw(10) << "gpu ms" << endl;
+        // a run of scopes with the same name (e.g. jobs the GL thread ran while it waited) is printed once
+        for (unsigned int i = 0; i < events.size();) {
+            const Event& event = events[i];
+            if (event.thread != 0 || event.end < 0.0) {
+                i++;
+                continue;
+            }
+            double cpu = 0.0, gpu = 0.0;
+            unsigned int count = 0;
+            unsigned int next = i;
+            for (; next < events.size(); next++) {
+                const Event& repeated = events[next];
+                if (repeated.thread != 0 || repeated.end < 0.0)
+                    continue;
+                if (repeated.name != event.name || repeated.depth != event.depth)
+                    break;
+                cpu += repeated.end - repeated.start;
+                gpu += repeated.gpuEnd - repeated.gpuStart;
+                count++;
+            }
+            string name = string(2 * event.depth + 2, ' ') + event.name + (count > 1 ? " x" + to_string(count) : "");
+            out << "          " << left << setw(44) << name << right << setw(10) << cpu / 1000.0;
+            if (gpu > 0.0)
+                out << setw(10) << gpu / 1000.0;
+            out << endl;
+            i = next;
+        }
+        // the jobs are many small scopes, they are summed by name
+        vector<pair<string, pair<unsigned int, double> > > jobs;
+        for (unsigned int i = 0; i < events.size(); i++) {
+            const Event& event = events[i];
+            if (event.thread == 0 || event.end < 0.0)
+                continue;
+            unsigned int j = 0;
+            while (j < jobs.size() && jobs[j].first != event.name)
+                j++;
+            if (j == jobs.size())
+                jobs.push_back(make_pair(event.name, make_pair(0u, 0.0)));
+            jobs[j].second.first++;
+            jobs[j].second.second += event.end - event.start;
+        }
+        if (!jobs.empty()) {
+            out << "STARTUP:: " << left << setw(44) << "jobs (summed over " + to_string(threads.size() - 1) + " threads)" << right
+                << setw(10) << "cpu ms" << setw(10) << "count" << endl;
+            for (unsigned int i = 0; i < jobs.size(); i++) {
+                out << "          " << left << setw(44) << "  " + jobs[i].first << right << setw(10) << jobs[i].second.second / 1000.0
+                    << setw(10) << jobs[i].second.first << endl;
+            }
+        }
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    static string escape(const string& text) {
+        string result;
+        for (unsigned int i = 0; i < text.size(); i++) {
+            if (text[i] == '"' || text[i] == '\\')
+                result += '\\';
+            result += text[i];
+        }
+        return result;
+    }
+
+    // the Chrome trace event format, complete events in microseconds
+    void writeTrace(const string& path) const {
+        ofstream file(path.c_str());
+        if (!file) {
+            cout << "ERROR::STARTUP_TRACE:: failed to write " << path << endl;
+            return;
+        }
+        const unsigned int GPU_TRACK = 1000;
+        file << fixed << setprecision(1);
+        file << "{\"traceEvents\": [" << endl;
+        for (unsigned int i = 0; i < threads.size(); i++) {
+            string name = i == 0 ? "GL thread" : "job thread " + to_string(i);
+            file << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << i << ", \"args\": {\"name\": \"" << name << "\"}}," << endl;
+        }
+        file << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << GPU_TRACK << ", \"args\": {\"name\": \"GPU\"}}," << endl;
+        for (unsigned int i = 0; i < events.size(); i++) {
+            const Event& event = events[i];
+            if (event.end < 0.0)
+                continue;
+            file << "  {\"name\": \"" << escape(event.name) << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread
+                << ", \"ts\": " << event.start << ", \"dur\": " << event.end - event.start << "}," << endl;
+            if (event.gpuEnd > event.gpuStart) {
+                file << "  {\"name\": \"" << escape(event.name) << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << GPU_TRACK
+                    << ", \"ts\": " << event.gpuStart << ", \"dur\": " << event.gpuEnd - event.gpuStart << "}," << endl;
+            }
+        }
+        file << "  {\"name\": \"first frame\", \"ph\": \"i\", \"s\": \"g\", \"pid\": 1, \"tid\": 0, \"ts\": " << firstFrame << "}" << endl;
+        file << "]}" << endl;
+        cout << "STARTUP:: trace written to " << path << endl;
+    }
+};
+
+// the trace of the application
+inline StartupTrace& startupTrace()
+{
+    static StartupTrace trace;
+    return trace;
+}
+
+// times the rest of the enclosing block
+class TraceScope
+{
+public:
+    explicit TraceScope(const string& name) : event(startupTrace().begin(name)) {}
+    ~TraceScope() {
+        startupTrace().end(event);
+    }
+
+private:
+    unsigned int event;
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+};
+#endif
@@ -0,0 +1,71 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// the jittered scene of this frame, it covers renderScale of the textures with dynamic resolution
+uniform sampler2D currentColor;
+uniform sampler2D velocityTexture;
+uniform sampler2D depthTexture;
+uniform vec2 renderScale;
+// the result of the previous frame at the output resolution
+uniform sampler2D history;
+uniform bool historyValid;
+// share of the history in the result
+uniform float historyWeight;
+
+vec3 RGBToYCoCg(vec3 color)
+{
+    return vec3(dot(color, vec3(0.25, 0.5, 0.25)), dot(color, vec3(0.5, 0.0, -0.5)), dot(color, vec3(-0.25, 0.5, -0.25)));
+}
+
+vec3 YCoCgToRGB(vec3 color)
+{
+    return vec3(color.x + color.y - color.z, color.x + color.z, color.x - color.y - color.z);
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(currentColor, 0));
+    vec2 uvMax = renderScale - 0.5 * texel;
+    vec2 uv = min(TexCoords * renderScale, uvMax);
+
+    // the 3x3 neighbourhood of the current frame bounds the history (in YCoCg, where the box fits colors tighter),
+    // the motion is taken from its nearest fragment so the edges of moving objects move with them
+    vec3 current = vec3(0.0);
+    vec3 lowest = vec3(1e9);
+    vec3 highest = vec3(-1e9);
+    float nearestDepth = 1.0;
+    vec2 nearestUV = uv;
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            vec2 sampleUV = clamp(uv + vec2(x, y) * texel, 0.5 * texel, uvMax);
+            vec3 color = RGBToYCoCg(texture(currentColor, sampleUV).rgb);
+            if (x == 0 && y == 0)
+                current = color;
+            lowest = min(lowest, color);
+            highest = max(highest, color);
+            float depth = texture(depthTexture, sampleUV).r;
+            if (depth < nearestDepth)
+            {
+                nearestDepth = depth;
+                nearestUV = sampleUV;
+            }
+        }
+    }
+
+    // where this pixel was in the previous frame, pixels that came into view have no history
+    vec2 previousUV = TexCoords - texture(velocityTexture, nearestUV).rg;
+    if (!historyValid || any(lessThan(previousUV, vec2(0.0))) || any(greaterThan(previousUV, vec2(1.0))))
+    {
+        FragColor = vec4(YCoCgToRGB(current), 1.0);
+        return;
+    }
+    vec3 previous = clamp(RGBToYCoCg(texture(history, previousUV).rgb), lowest, highest);
+    // weighted by the inverse luminance, so single bright samples don't flicker after tonemapping
+    float currentWeight = (1.0 - historyWeight) / (1.0 + current.x);
+    float previousWeight = historyWeight / (1.0 + previous.x);
+    FragColor = vec4(YCoCgToRGB((current * currentWeight + previous * previousWeight) / (currentWeight + previousWeight)), 1.0);
+}
@@ -0,0 +1,112 @@
+#ifndef TAA_H
+#define TAA_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "gl_state.h"
+
+// Temporal anti-aliasing: every frame the projection is shifted by a different sub-pixel offset, and the
+// result is blended with the previous ones reprojected by the motion vectors of the scene. History that no longer
+// matches (disocclusion, shading changes) is clamped to the colors around the pixel in the current frame. The
+// history has the full size of the targets, so with dynamic resolution the scene is also upsampled over time.
+class TemporalAA
+{
+public:
+    // length of the jitter sequence
+    static const unsigned int SAMPLE_COUNT = 8;
+
+    // share of the history in every new frame
+    float historyWeight = 0.9f;
+
+    TemporalAA() : resolveShader("bloom_final.vs", "", "taa.fs") {}
+
+    // creates the history for targets of the given size
+    void init(unsigned int targetWidth, unsigned int targetHeight) {
+        width = targetWidth;
+        height = targetHeight;
+        glGenTextures(2, historyTextures);
+        glGenFramebuffers(2, historyFBOs);
+        for (unsigned int i = 0; i < 2; i++) {
+            glState().bindTexture(GL_TEXTURE_2D, historyTextures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glState().bindFramebuffer(historyFBOs[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historyTextures[i], 0);
+        }
+        glState().bindFramebuffer(0);
+
+        resolveShader.use();
+        resolveShader.setIntUniform("currentColor", 0);
+        resolveShader.setIntUniform("velocityTexture", 1);
+        resolveShader.setIntUniform("depthTexture", 2);
+        resolveShader.setIntUniform("history", 3);
+    }
+
+    // the offset of the next frame in ndc for a viewport of the given size, from the Halton (2, 3) sequence
+    glm::vec2 nextJitter(unsigned int viewportWidth, unsigned int viewportHeight) {
+        frame = (frame + 1) % SAMPLE_COUNT;
+        glm::vec2 offset(halton(frame + 1, 2) - 0.5f, halton(frame + 1, 3) - 0.5f);
+        return glm::vec2(offset.x * 2.0f / viewportWidth, offset.y * 2.0f / viewportHeight);
+    }
+
+    // the projection moved by an offset in ndc
+    static glm::mat4 jitterProjection(glm::mat4 projection, glm::vec2 jitter) {
+        // ndc.xy = clip.xy / -z, so the terms multiplied with z shift the whole image
+        projection[2][0] -= jitter.x;
+        projection[2][1] -= jitter.y;
+        return projection;
+    }
+
+    // drops the history, e.g. after frames that weren't resolved
+    void invalidate() {
+        historyValid = false;
+    }
+
+    // blends the scene into the history and returns the texture with the result, which covers the whole target.
+    // The scene covers renderScale of its textures (see DynamicResolution), drawQuad draws a full screen quad.
+    GLuint resolve(GLuint colorTexture, GLuint velocityTexture, GLuint depthTexture, glm::vec2 renderScale, void (*drawQuad)()) {
+        unsigned int previous = current;
+        current = 1 - current;
+        glState().bindFramebuffer(historyFBOs[current]);
+        glState().viewport(0, 0, width, height);
+        resolveShader.use();
+        resolveShader.setVec2Uniform("renderScale", renderScale);
+        resolveShader.setBoolUniform("historyValid", historyValid);
+        resolveShader.setFloatUniform("historyWeight", historyWeight);
+        glState().bindTexture(0, GL_TEXTURE_2D, colorTexture);
+        glState().bindTexture(1, GL_TEXTURE_2D, velocityTexture);
+        glState().bindTexture(2, GL_TEXTURE_2D, depthTexture);
+        glState().bindTexture(3, GL_TEXTURE_2D, historyTextures[previous]);
+        glState().activeTexture(GL_TEXTURE0);
+        drawQuad();
+        glState().bindFramebuffer(0);
+        historyValid = true;
+        return historyTextures[current];
+    }
+
+private:
+    Shader resolveShader;
+    unsigned int width = 0, height = 0;
+    GLuint historyTextures[2] = {};
+    GLuint historyFBOs[2] = {};
+    unsigned int current = 0;
+    unsigned int frame = 0;
+    bool historyValid = false;
+
+    static float halton(unsigned int index, unsigned int base) {
+        float result = 0.0f, fraction = 1.0f;
+        while (index > 0) {
+            fraction /= base;
+            result += fraction * (index % base);
+            index /= base;
+        }
+        return result;
+    }
+};
+#endif
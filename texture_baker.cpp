@@ -0,0 +1,194 @@
+// Offline texture baker: compresses the textures referenced by Wavefront .mtl files into DDS files with a full
+// mip chain, stored next to the source images. The block format follows the role of the map in the material:
+//   map_Kd (albedo)                  BC1, or BC3 if the image has alpha
+//   map_Ke (emissive)                BC1
+//   map_Kn / norm (normal)           BC5, the shader reconstructs z
+//   map_d (opacity)                  BC4 of the red channel
+// The ao, roughness, metallic and height maps are packed into one texture at import (see texture_packing.h)
+// and are not baked. An image used with different roles isn't baked either, no single format fits all of them.
+// The mip levels are filtered like the ones generated at load time (see mip_generator.h).
+// The application picks up a .dds next to an image automatically (see TextureFromFile).
+//
+// usage: TextureBaker <material.mtl> [<material.mtl> ...]
+
+#include "stb_image.h"
+
+#include "mip_generator.h"
+#include "texture_compression.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+enum TextureRole {
+    ROLE_ALBEDO,
+    ROLE_EMISSIVE,
+    ROLE_NORMAL,
+    ROLE_SINGLE_CHANNEL
+};
+
+struct BakeJob {
+    string path;
+    TextureRole role;
+    // the image is used with another role too
+    bool conflicting = false;
+};
+
+mutex outputMutex;
+
+bool bake(const BakeJob& job)
+{
+    int width, height, components;
+    unsigned char* data = stbi_load(job.path.c_str(), &width, &height, &components, 4);
+    if (!data) {
+        lock_guard<mutex> lock(outputMutex);
+        cout << "ERROR::TEXTURE_BAKER:: failed to load " << job.path << endl;
+        return false;
+    }
+    vector<unsigned char> pixels(data, data + width * height * 4);
+    stbi_image_free(data);
+
+    BlockFormat format = FORMAT_BC4;
+    MipFilter filter = MIP_LINEAR;
+    if (job.role == ROLE_ALBEDO) {
+        filter = MIP_COLOR;
+        format = FORMAT_BC1;
+        for (size_t i = 3; i < pixels.size(); i += 4) {
+            if (pixels[i] != 255) {
+                format = FORMAT_BC3;
+                break;
+            }
+        }
+    }
+    else if (job.role == ROLE_EMISSIVE) {
+        format = FORMAT_BC1;
+        filter = MIP_COLOR;
+    }
+    else if (job.role == ROLE_NORMAL) {
+        format = FORMAT_BC5;
+        filter = MIP_NORMAL;
+    }
+
+    CompressedImage image;
+    image.format = format;
+    image.width = width;
+    image.height = height;
+    MipChain chain = generateMipChain(pixels.data(), width, height, filter);
+    for (unsigned int level = 0; level < chain.levels.size(); level++)
+        image.levels.push_back(compressImage(chain.levels[level].data(), chain.levelWidth(level), chain.levelHeight(level), format));
+
+    string output = job.path.substr(0, job.path.find_last_of('.')) + ".dds";
+    bool written = writeDDS(output, image);
+    lock_guard<mutex> lock(outputMutex);
+    if (written)
+        cout << "TEXTURE_BAKER:: " << output << " (" << fourCCOf(format) << ", " << image.levels.size() << " levels)" << endl;
+    else
+        cout << "ERROR::TEXTURE_BAKER:: failed to write " << output << endl;
+    return written;
+}
+
+const char* roleName(TextureRole role)
+{
+    switch (role) {
+    case ROLE_ALBEDO:
+        return "albedo";
+    case ROLE_EMISSIVE:
+        return "emissive";
+    case ROLE_NORMAL:
+        return "normal";
+    default:
+        return "single channel";
+    }
+}
+
+// collects the textures of a material library, every texture only once. An image listed with two roles (here or
+// in another library) is marked as conflicting.
+void readMaterialLibrary(const string& path, vector<BakeJob>& jobs)
+{
+    ifstream file(path.c_str());
+    if (!file) {
+        cout << "ERROR::TEXTURE_BAKER:: failed to open " << path << endl;
+        return;
+    }
+    string directory = path.find_last_of("/\\") == string::npos ? "." : path.substr(0, path.find_last_of("/\\"));
+    string line;
+    while (getline(file, line)) {
+        istringstream stream(line);
+        string key, name;
+        stream >> key;
+        getline(stream >> ws, name);
+        if (!name.empty() && name[name.size() - 1] == '\r')
+            name.erase(name.size() - 1);
+        if (name.empty())
+            continue;
+        BakeJob job;
+        if (key == "map_Kd")
+            job.role = ROLE_ALBEDO;
+        else if (key == "map_Ke")
+            job.role = ROLE_EMISSIVE;
+        else if (key == "map_Kn" || key == "norm")
+            job.role = ROLE_NORMAL;
+        else if (key == "map_d")
+            job.role = ROLE_SINGLE_CHANNEL;
+        else
+            continue;
+        job.path = directory + '/' + name;
+        bool known = false;
+        for (unsigned int i = 0; i < jobs.size() && !known; i++) {
+            if (jobs[i].path != job.path)
+                continue;
+            known = true;
+            if (jobs[i].role != job.role && !jobs[i].conflicting) {
+                cout << "ERROR::TEXTURE_BAKER:: " << job.path << " is used as " << roleName(jobs[i].role) << " and as "
+                    << roleName(job.role) << " map (" << path << "), it is not baked" << endl;
+                jobs[i].conflicting = true;
+            }
+        }
+        if (!known)
+            jobs.push_back(job);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        cout << "usage: TextureBaker <material.mtl> [<material.mtl> ...]" << endl;
+        return 1;
+    }
+    vector<BakeJob> jobs;
+    for (int i = 1; i < argc; i++)
+        readMaterialLibrary(argv[i], jobs);
+    // the application loads the source image of a conflicting texture and generates the mip levels of its role,
+    // unless a .dds baked earlier for one of the roles is still there
+    for (unsigned int i = 0; i < jobs.size(); i++) {
+        if (jobs[i].conflicting)
+            std::remove((jobs[i].path.substr(0, jobs[i].path.find_last_of('.')) + ".dds").c_str());
+    }
+    jobs.erase(remove_if(jobs.begin(), jobs.end(), [](const BakeJob& job) { return job.conflicting; }), jobs.end());
+
+    // every worker takes the next texture until all are done
+    atomic<size_t> nextJob(0);
+    atomic<unsigned int> failed(0);
+    unsigned int workerCount = std::max(1u, std::min(thread::hardware_concurrency(), (unsigned int)jobs.size()));
+    vector<thread> workers;
+    for (unsigned int i = 0; i < workerCount; i++) {
+        workers.push_back(thread([&]() {
+            for (size_t job = nextJob++; job < jobs.size(); job = nextJob++) {
+                if (!bake(jobs[job]))
+                    failed++;
+            }
+        }));
+    }
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+    cout << "TEXTURE_BAKER:: baked " << jobs.size() - failed << " of " << jobs.size() << " textures" << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Block compression (BC1/BC3/BC4/BC5) of 8 bit images and the DDS files the compressed mip chains are stored in.
+// Shared by the offline TextureBaker and the texture loader of the application.
+
+enum BlockFormat {
+    FORMAT_BC1 = 0, // rgb, 4 bpp: albedo and emissive maps
+    FORMAT_BC3,     // rgba, 8 bpp: albedo maps with alpha
+    FORMAT_BC4,     // single channel, 4 bpp: opacity maps
+    FORMAT_BC5      // two channels, 8 bpp: tangent space normal maps (z is reconstructed in the shader)
+};
+
+inline unsigned int blockBytes(BlockFormat format) {
+    return format == FORMAT_BC1 || format == FORMAT_BC4 ? 8 : 16;
+}
+
+// size in bytes of one compressed mip level
+inline unsigned int compressedSize(BlockFormat format, unsigned int width, unsigned int height) {
+    return std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * blockBytes(format);
+}
+
+// ----------------------------------------------------------------------------
+// block encoders, input is a 4x4 block of rgba pixels (row by row)
+
+inline uint16_t packColor565(const float color[3]) {
+    int r = std::min(31, std::max(0, (int)(color[0] * 31.0f / 255.0f + 0.5f)));
+    int g = std::min(63, std::max(0, (int)(color[1] * 63.0f / 255.0f + 0.5f)));
+    int b = std::min(31, std::max(0, (int)(color[2] * 31.0f / 255.0f + 0.5f)));
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void unpackColor565(uint16_t packed, float color[3]) {
+    color[0] = (float)((packed >> 11) & 31) * 255.0f / 31.0f;
+    color[1] = (float)((packed >> 5) & 63) * 255.0f / 63.0f;
+    color[2] = (float)(packed & 31) * 255.0f / 31.0f;
+}
+
+// BC1 color block: the end points are the extremes of the pixels along their principal axis
+inline void encodeColorBlock(const unsigned char* pixels, unsigned char* block) {
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += pixels[i * 4 + c] / 16.0f;
+    float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++) {
+        float d[3] = { pixels[i * 4] - mean[0], pixels[i * 4 + 1] - mean[1], pixels[i * 4 + 2] - mean[2] };
+        covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+    }
+    // power iteration for the principal axis
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2] };
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+    float minimum = 1e30f, maximum = -1e30f;
+    for (int i = 0; i < 16; i++) {
+        float t = (pixels[i * 4] - mean[0]) * axis[0] + (pixels[i * 4 + 1] - mean[1]) * axis[1] + (pixels[i * 4 + 2] - mean[2]) * axis[2];
+        minimum = std::min(minimum, t);
+        maximum = std::max(maximum, t);
+    }
+    // inset the end points a little, the extremes are rarely hit exactly
+    float inset = (maximum - minimum) / 16.0f;
+    float endPoints[2][3];
+    for (int c = 0; c < 3; c++) {
+        endPoints[0][c] = mean[c] + axis[c] * (maximum - inset);
+        endPoints[1][c] = mean[c] + axis[c] * (minimum + inset);
+    }
+    uint16_t color0 = packColor565(endPoints[0]), color1 = packColor565(endPoints[1]);
+    // color0 > color1 selects the four color mode
+    if (color0 < color1)
+        std::swap(color0, color1);
+    float palette[4][3];
+    unpackColor565(color0, palette[0]);
+    unpackColor565(color1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            float bestDistance = 1e30f;
+            for (int p = 0; p < 4; p++) {
+                float dr = pixels[i * 4] - palette[p][0], dg = pixels[i * 4 + 1] - palette[p][1], db = pixels[i * 4 + 2] - palette[p][2];
+                float distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+    block[0] = color0 & 0xFF; block[1] = color0 >> 8;
+    block[2] = color1 & 0xFF; block[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++)
+        block[4 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+// BC4 block of one channel of the pixels, in the eight value mode
+inline void encodeChannelBlock(const unsigned char* pixels, int channel, unsigned char* block) {
+    int minimum = 255, maximum = 0;
+    for (int i = 0; i < 16; i++) {
+        minimum = std::min(minimum, (int)pixels[i * 4 + channel]);
+        maximum = std::max(maximum, (int)pixels[i * 4 + channel]);
+    }
+    int palette[8];
+    palette[0] = maximum;
+    palette[1] = minimum;
+    for (int i = 1; i < 7; i++)
+        palette[i + 1] = ((7 - i) * maximum + i * minimum + 3) / 7;
+    uint64_t indices = 0;
+    for (int i = 0; i < 16 && maximum != minimum; i++) {
+        int value = pixels[i * 4 + channel];
+        int best = 0;
+        for (int p = 1; p < 8; p++) {
+            if (std::abs(palette[p] - value) < std::abs(palette[best] - value))
+                best = p;
+        }
+        indices |= (uint64_t)best << (i * 3);
+    }
+    block[0] = (unsigned char)maximum;
+    block[1] = (unsigned char)minimum;
+    for (int i = 0; i < 6; i++)
+        block[2 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+// compresses an rgba image, blocks reaching over the border repeat the last row/column
+inline vector<unsigned char> compressImage(const unsigned char* rgba, unsigned int width, unsigned int height, BlockFormat format) {
+    vector<unsigned char> result(compressedSize(format, width, height));
+    unsigned char* out = result.data();
+    unsigned char pixels[64];
+    for (unsigned int by = 0; by < height; by += 4) {
+        for (unsigned int bx = 0; bx < width; bx += 4) {
+            for (unsigned int y = 0; y < 4; y++) {
+                for (unsigned int x = 0; x < 4; x++) {
+                    unsigned int sx = std::min(bx + x, width - 1), sy = std::min(by + y, height - 1);
+                    std::memcpy(&pixels[(y * 4 + x) * 4], &rgba[(sy * width + sx) * 4], 4);
+                }
+            }
+            switch (format) {
+            case FORMAT_BC1:
+                encodeColorBlock(pixels, out);
+                break;
+            case FORMAT_BC3:
+                encodeChannelBlock(pixels, 3, out);
+                encodeColorBlock(pixels, out + 8);
+                break;
+            case FORMAT_BC4:
+                encodeChannelBlock(pixels, 0, out);
+                break;
+            case FORMAT_BC5:
+                encodeChannelBlock(pixels, 0, out);
+                encodeChannelBlock(pixels, 1, out + 8);
+                break;
+            }
+            out += blockBytes(format);
+        }
+    }
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+// DDS files: a legacy header with a FourCC code (DXT1, DXT5, ATI1, ATI2) and the mip levels one after another
+
+struct DDSPixelFormat {
+    uint32_t size, flags, fourCC, rgbBitCount, rBitMask, gBitMask, bBitMask, aBitMask;
+};
+
+struct DDSHeader {
+    uint32_t size, flags, height, width, pitchOrLinearSize, depth, mipMapCount;
+    uint32_t reserved1[11];
+    DDSPixelFormat pixelFormat;
+    uint32_t caps, caps2, caps3, caps4, reserved2;
+};
+
+// a compressed texture with all its mip levels
+struct CompressedImage {
+    BlockFormat format;
+    unsigned int width = 0, height = 0;
+    vector<vector<unsigned char> > levels;
+};
+
+inline uint32_t makeFourCC(const char* code) {
+    return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+}
+
+inline const char* fourCCOf(BlockFormat format) {
+    static const char* codes[] = { "DXT1", "DXT5", "ATI1", "ATI2" };
+    return codes[format];
+}
+
+inline bool writeDDS(const string& path, const CompressedImage& image) {
+    ofstream file(path.c_str(), ios::binary);
+    if (!file)
+        return false;
+    DDSHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.size = sizeof(DDSHeader);
+    header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // caps, height, width, pixel format, mip count, linear size
+    header.height = image.height;
+    header.width = image.width;
+    header.pitchOrLinearSize = compressedSize(image.format, image.width, image.height);
+    header.mipMapCount = (uint32_t)image.levels.size();
+    header.pixelFormat.size = sizeof(DDSPixelFormat);
+    header.pixelFormat.flags = 0x4; // four CC
+    header.pixelFormat.fourCC = makeFourCC(fourCCOf(image.format));
+    header.caps = 0x1000 | 0x400000 | 0x8; // texture, mipmap, complex
+    file.write("DDS ", 4);
+    file.write((const char*)&header, sizeof(header));
+    for (unsigned int i = 0; i < image.levels.size(); i++)
+        file.write((const char*)image.levels[i].data(), image.levels[i].size());
+    return (bool)file;
+}
+
+inline bool readDDS(const string& path, CompressedImage& image) {
+    ifstream file(path.c_str(), ios::binary);
+    if (!file)
+        return false;
+    char magic[4];
+    DDSHeader header;
+    if (!file.read(magic, 4) || std::memcmp(magic, "DDS ", 4) != 0 || !file.read((char*)&header, sizeof(header)))
+        return false;
+    bool known = false;
+    for (int format = FORMAT_BC1; format <= FORMAT_BC5; format++) {
+        if (header.pixelFormat.fourCC == makeFourCC(fourCCOf((BlockFormat)format))) {
+            image.format = (BlockFormat)format;
+            known = true;
+        }
+    }
+    if (!known)
+        return false;
+    image.width = header.width;
+    image.height = header.height;
+    unsigned int levelCount = std::max(1u, header.mipMapCount);
+    image.levels.resize(levelCount);
+    unsigned int width = image.width, height = image.height;
+    for (unsigned int i = 0; i < levelCount; i++) {
+        image.levels[i].resize(compressedSize(image.format, width, height));
+        if (!file.read((char*)image.levels[i].data(), image.levels[i].size()))
+            return false;
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+    return true;
+}
+#endif
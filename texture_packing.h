@@ -0,0 +1,102 @@
+#ifndef TEXTURE_PACKING_H
+#define TEXTURE_PACKING_H
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Channels of the packed ORM texture of a material, every channel comes from the red channel of its own image
+enum PackedChannel {
+    ORM_AO = 0,        // r: ambient occlusion, linearized (the source maps are sRGB)
+    ORM_ROUGHNESS = 1, // g
+    ORM_METALLIC = 2,  // b
+    ORM_HEIGHT = 3,    // a: parallax height map
+    ORM_CHANNELS = 4
+};
+
+// source images of a packed texture, empty paths use the default value of the channel
+struct PackedTextureSources {
+    string paths[ORM_CHANNELS];
+    // normal map of the material, not packed but used to filter the roughness mips (see applyToksvig)
+    string normalPath;
+
+    bool empty() const {
+        for (int i = 0; i < ORM_CHANNELS; i++) {
+            if (!paths[i].empty())
+                return false;
+        }
+        return true;
+    }
+
+    // identifies the packing in the texture cache
+    string key() const {
+        string result = "orm";
+        for (int i = 0; i < ORM_CHANNELS; i++)
+            result += "|" + paths[i];
+        if (!normalPath.empty())
+            result += "|n:" + normalPath;
+        return result;
+    }
+};
+
+// value of a channel without a source image: no occlusion, fully rough, dielectric, no displacement
+inline unsigned char packedChannelDefault(int channel) {
+    static const unsigned char defaults[ORM_CHANNELS] = { 255, 255, 0, 255 };
+    return defaults[channel];
+}
+
+// Packs the source images into one rgba image. Images of different sizes are resampled (nearest) to the
+// largest one. Returns false if none of the sources could be loaded.
+inline bool packTextures(const PackedTextureSources& sources, vector<unsigned char>& rgba, int& width, int& height) {
+    unsigned char* images[ORM_CHANNELS] = {};
+    int widths[ORM_CHANNELS] = {}, heights[ORM_CHANNELS] = {};
+    width = 0;
+    height = 0;
+    for (int i = 0; i < ORM_CHANNELS; i++) {
+        if (sources.paths[i].empty())
+            continue;
+        int components;
+        images[i] = stbi_load(sources.paths[i].c_str(), &widths[i], &heights[i], &components, 4);
+        if (images[i]) {
+            width = std::max(width, widths[i]);
+            height = std::max(height, heights[i]);
+        }
+    }
+    if (width == 0 || height == 0)
+        return false;
+
+    // sRGB to linear lookup for the ao channel
+    unsigned char linear[256];
+    for (int i = 0; i < 256; i++) {
+        float value = i / 255.0f;
+        value = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        linear[i] = (unsigned char)(value * 255.0f + 0.5f);
+    }
+
+    rgba.resize((size_t)width * height * 4);
+    for (int channel = 0; channel < ORM_CHANNELS; channel++) {
+        const unsigned char* image = images[channel];
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                unsigned char value = packedChannelDefault(channel);
+                if (image) {
+                    int sx = x * widths[channel] / width, sy = y * heights[channel] / height;
+                    value = image[((size_t)sy * widths[channel] + sx) * 4];
+                    if (channel == ORM_AO)
+                        value = linear[value];
+                }
+                rgba[((size_t)y * width + x) * 4 + channel] = value;
+            }
+        }
+    }
+    for (int i = 0; i < ORM_CHANNELS; i++) {
+        if (images[i])
+            stbi_image_free(images[i]);
+    }
+    return true;
+}
+#endif
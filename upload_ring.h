@@ -0,0 +1,223 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "gl_extensions.h"
+#include "gl_state.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// uniform block binding points shared by all shaders
+const unsigned int FRAME_UNIFORM_BINDING = 0;
+const unsigned int OBJECT_UNIFORM_BINDING = 1;
+
+// std140 layout of the FrameData block (frame_data.glsl): camera, light and toggles, written once per frame
+struct FrameUniforms {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 shadowMatrices[6];
+    glm::vec4 viewPos;      // xyz: camera position in world space
+    glm::vec4 lightPos;     // xyz: point light position in world space
+    glm::vec4 lightColor;   // rgb: point light color
+    glm::vec4 params;       // x: far plane of the shadow cubemap, y: parallax height scale
+    int shadows;            // toggles, an ivec4 in the block
+    int parallax;
+    int padding[2];
+    glm::mat4 previousViewProjection; // unjittered, for the motion vectors
+    glm::vec4 jitter;       // xy: sub-pixel offset of the projection in ndc (see TemporalAA)
+};
+
+// std140 layout of the ObjectData block (frame_data.glsl), one entry per draw call
+struct ObjectUniforms {
+    glm::mat4 model;
+    glm::mat4 normalMatrix;
+    int shadowFaces;        // bit mask of the shadow cubemap faces the object touches, an ivec4 in the block
+    int padding[3];
+};
+
+// Ring of FRAME_COUNT regions in one buffer for the data the CPU writes every frame (uniform blocks, vertex
+// streams, pixels for texture uploads), so the CPU fills one region while the GPU still reads the previous ones.
+// Every region is guarded by a fence, nothing is written with glBufferData or glBufferSubData that could wait for
+// the GPU. The data of a frame is gathered in a CPU-side staging copy first and then uploaded with a memcpy into
+// the persistently mapped buffer (GL_ARB_buffer_storage) or, on plain GL 3.3, into an unsynchronized mapping of
+// the region. A frame may upload several times, e.g. once for the uniforms and later for data that is only known
+// after a pass ran. The buffer can be bound to any target, offsets of the region become buffer offsets with
+// bufferOffset().
+class UploadRing
+{
+public:
+    static const unsigned int FRAME_COUNT = 3;
+
+    GLuint buffer = 0;
+    bool persistent = false;
+    // number of times the CPU had to wait for the GPU to release a region, stays 0 while the ring is big enough
+    // and the GPU is at most FRAME_COUNT - 1 frames behind
+    unsigned int stalls = 0;
+    // stalls of the last finished frame
+    unsigned int lastFrameStalls = 0;
+    // number of times the regions had to grow
+    unsigned int reallocations = 0;
+    // bytes of the last finished frame
+    size_t lastFrameBytes = 0;
+
+    ~UploadRing() {
+        for (unsigned int i = 0; i < FRAME_COUNT; i++) {
+            if (fences[i])
+                glDeleteSync(fences[i]);
+        }
+    }
+
+    // creates the buffer with room for regionSize bytes per frame
+    void init(GLsizeiptr regionSize) {
+        GLint offsetAlignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+        uniformAlignment = offsetAlignment;
+        allocate(align(regionSize, uniformAlignment));
+    }
+
+    // starts gathering the data of a new frame
+    void begin() {
+        staging.clear();
+        uploadedSize = 0;
+        frameStartStalls = stalls;
+    }
+
+    // appends data to the staging copy and returns its offset inside the region. Uniform blocks need the
+    // default alignment, vertex and pixel data only that of their elements.
+    GLintptr push(const void* data, GLsizeiptr size, GLsizeiptr alignment = 0) {
+        GLintptr offset = align(static_cast<GLsizeiptr>(staging.size()), alignment > 0 ? alignment : uniformAlignment);
+        staging.resize(offset + size);
+        std::memcpy(&staging[offset], data, size);
+        return offset;
+    }
+
+    // copies the data pushed since the last upload of the frame into the current region
+    void upload() {
+        GLsizeiptr size = static_cast<GLsizeiptr>(staging.size());
+        if (size > regionSize) {
+            // the regions are too small for this frame, the old buffer may still be in use so orphan it. Blocks
+            // uploaded before this frame are in the old buffer, they are copied again.
+            allocate(align(size * 2, uniformAlignment));
+            uploadedSize = 0;
+        }
+        if (uploadedSize == 0)
+            waitForRegion(current);
+        if (size > uploadedSize) {
+            GLintptr offset = current * regionSize + uploadedSize;
+            if (persistent) {
+                std::memcpy(mapped + offset, &staging[uploadedSize], size - uploadedSize);
+            }
+            else {
+                glState().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+                void* pointer = glMapBufferRange(GL_UNIFORM_BUFFER, offset, size - uploadedSize,
+                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+                std::memcpy(pointer, &staging[uploadedSize], size - uploadedSize);
+                glUnmapBuffer(GL_UNIFORM_BUFFER);
+            }
+        }
+        uploadedSize = size;
+    }
+
+    // the offset in the buffer of data uploaded this frame
+    GLintptr bufferOffset(GLintptr offset) const {
+        return current * regionSize + offset;
+    }
+
+    // binds a block uploaded this frame to a uniform binding point
+    void bindRange(GLuint binding, GLintptr offset, GLsizeiptr size) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, bufferOffset(offset), size);
+    }
+
+    // fences the region the GPU reads this frame and moves on to the next one
+    void end() {
+        if (fences[current])
+            glDeleteSync(fences[current]);
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        current = (current + 1) % FRAME_COUNT;
+        lastFrameBytes = staging.size();
+        lastFrameStalls = stalls - frameStartStalls;
+    }
+
+private:
+    GLsizeiptr uniformAlignment = 256;
+    GLsizeiptr regionSize = 0;
+    // bytes of the staging copy already in the region
+    GLsizeiptr uploadedSize = 0;
+    unsigned int current = 0;
+    unsigned int frameStartStalls = 0;
+    GLsync fences[FRAME_COUNT] = {};
+    char* mapped = nullptr;
+    vector<char> staging;
+
+    static GLsizeiptr align(GLsizeiptr size, GLsizeiptr alignment) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    void allocate(GLsizeiptr size) {
+        if (buffer) {
+            // deleting a buffer the GPU still reads is fine, GL keeps it alive until the commands are done
+            glState().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+            if (persistent)
+                glUnmapBuffer(GL_UNIFORM_BUFFER);
+            deleteBuffer();
+            for (unsigned int i = 0; i < FRAME_COUNT; i++) {
+                if (fences[i])
+                    glDeleteSync(fences[i]);
+                fences[i] = 0;
+            }
+        }
+        if (regionSize > 0)
+            reallocations++;
+        regionSize = size;
+        glGenBuffers(1, &buffer);
+        glState().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        persistent = glExtensions().bufferStorage;
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glExtensions().glBufferStorage(GL_UNIFORM_BUFFER, regionSize * FRAME_COUNT, nullptr, flags);
+            mapped = (char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, regionSize * FRAME_COUNT, flags);
+            if (mapped == nullptr) {
+                cout << "ERROR::UPLOAD_RING:: persistent mapping failed, falling back to mapping per frame" << endl;
+                persistent = false;
+                deleteBuffer();
+                glGenBuffers(1, &buffer);
+                glState().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+            }
+        }
+        if (!persistent)
+            glBufferData(GL_UNIFORM_BUFFER, regionSize * FRAME_COUNT, nullptr, GL_STREAM_DRAW);
+        glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // GL unbinds a deleted buffer from every target it is bound to, behind the back of glState(). A new buffer can
+    // get the same name, the cache would then skip its bind, so the buffer is unbound through glState() first
+    // from all targets the ring is used with (vertex streams, pixel uploads and the uniform blocks).
+    void deleteBuffer() {
+        glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+        glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+
+    void waitForRegion(unsigned int region) {
+        if (!fences[region])
+            return;
+        GLenum result = glClientWaitSync(fences[region], 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+            stalls++;
+            do {
+                result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            } while (result == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fences[region]);
+        fences[region] = 0;
+    }
+};
+#endif
@@ -0,0 +1,6 @@
+// Motion of a fragment since the previous frame, in texture coordinates of the screen. Both positions are in
+// clip space without the jitter of the projection (see TemporalAA), so a still camera gives no motion.
+vec2 ScreenVelocity(vec4 currentClipPos, vec4 previousClipPos)
+{
+    return (currentClipPos.xy / currentClipPos.w - previousClipPos.xy / previousClipPos.w) * 0.5;
+}